@@ -1 +1 @@
-g++ -o rhino compiler/*.c compiler/core/*.c compiler/data/*.c -g -fcompare-debug-second
\ No newline at end of file
+g++ -o rhino compiler/*.c compiler/core/*.c compiler/data/*.c -g -fcompare-debug-second -pthread
\ No newline at end of file
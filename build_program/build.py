@@ -183,4 +183,89 @@ with create_include("patch_payload.c") as f:
         f.write("\t} as = {.data = p};\n")
         f.write("\tfor (size_t i = 0; i < wordsizeof(" + payload + "); i++)\n")
         f.write("\t\tunit->instruction[location + i].word = as.word[i];\n")
-        f.write("}\n\n")
\ No newline at end of file
+        f.write("}\n\n")
+# KEYWORDS #
+# Generates a perfect hash over the keywords in LIST_TOKENS, using the length and the first and last character of the word
+
+keywords = []
+with open("compiler/data/token.h", "r") as f:
+    for line in f:
+        segment = line.split()
+        if len(segment) > 0 and segment[0].startswith("MACRO(KEYWORD_"):
+            keywords.append(segment[0][len("MACRO(KEYWORD_"):-1].lower())
+
+def keyword_hash(word, a, b, c, size):
+    return (len(word) * a + ord(word[0]) * b + ord(word[-1]) * c) & (size - 1)
+
+def find_keyword_hash():
+    size = 16
+    while True:
+        if size >= len(keywords):
+            for a in range(1, 32):
+                for b in range(1, 32):
+                    for c in range(1, 32):
+                        slots = set(keyword_hash(k, a, b, c, size) for k in keywords)
+                        if len(slots) == len(keywords):
+                            return (a, b, c, size)
+        size *= 2
+
+with create_include("keyword_hash.c") as f:
+    a, b, c, size = find_keyword_hash()
+
+    table = [None] * size
+    for keyword in keywords:
+        table[keyword_hash(keyword, a, b, c, size)] = keyword
+
+    f.write("typedef struct\n{\n")
+    f.write("\tconst char *word;\n")
+    f.write("\tsize_t len;\n")
+    f.write("\tTokenKind kind;\n")
+    f.write("} KeywordSlot;\n\n")
+
+    f.write("KeywordSlot keyword_slot[" + str(size) + "] = {\n")
+    for keyword in table:
+        if keyword:
+            f.write("\t{\"" + keyword + "\", " + str(len(keyword)) + ", KEYWORD_" + keyword.upper() + "},\n")
+        else:
+            f.write("\t{\"\", 0, IDENTITY},\n")
+    f.write("};\n\n")
+
+    f.write("// Returns the kind of keyword that the word is, or IDENTITY if it is not a keyword\n")
+    f.write("TokenKind get_keyword_kind(const char *word, size_t len)\n")
+    f.write("{\n")
+    f.write("\tsize_t hash = (len * " + str(a) + " + (uint8_t)word[0] * " + str(b) + " + (uint8_t)word[len - 1] * " + str(c) + ") & " + str(size - 1) + ";\n")
+    f.write("\tKeywordSlot slot = keyword_slot[hash];\n")
+    f.write("\tif (slot.len == len && memcmp(slot.word, word, len) == 0)\n")
+    f.write("\t\treturn slot.kind;\n")
+    f.write("\treturn IDENTITY;\n")
+    f.write("}\n")
+
+# POWERS OF TEN #
+# Generates 128-bit approximations (rounded down) of the powers of ten, used to convert decimal literals to doubles
+
+POWER_OF_TEN_MIN = -348
+POWER_OF_TEN_MAX = 347
+
+with create_include("power_of_ten.c") as f:
+    f.write("#define POWER_OF_TEN_MIN " + str(POWER_OF_TEN_MIN) + "\n")
+    f.write("#define POWER_OF_TEN_MAX " + str(POWER_OF_TEN_MAX) + "\n\n")
+
+    f.write("// The 128-bit mantissa of each power of ten, as {high, low}\n")
+    f.write("uint64_t power_of_ten[" + str(POWER_OF_TEN_MAX - POWER_OF_TEN_MIN + 1) + "][2] = {\n")
+    for e in range(POWER_OF_TEN_MIN, POWER_OF_TEN_MAX + 1):
+        if e >= 0:
+            n = 10 ** e
+            shift = n.bit_length() - 128
+            m = n >> shift if shift >= 0 else n << -shift
+        else:
+            d = 10 ** -e
+            k = 128 + d.bit_length() - 1
+            m = (1 << k) // d
+            while m.bit_length() > 128:
+                k -= 1
+                m = (1 << k) // d
+            while m.bit_length() < 128:
+                k += 1
+                m = (1 << k) // d
+        f.write("\t{0x%016x, 0x%016x}, // 1e%d\n" % (m >> 64, m & ((1 << 64) - 1), e))
+    f.write("};\n")
@@ -6,6 +6,7 @@
 #include "data/compiler.h"
 #include "data/byte_code.h"
 
-void assemble(Compiler *compiler, Program *apm, ByteCode *byte_code);
+void assemble(Compiler *compiler, Program *apm, ByteCode *byte_code, bool lazy);
+Unit *link_stub(Unit *stub, Unit *caller, size_t payload);
 
 #endif
\ No newline at end of file
@@ -33,19 +33,23 @@ typedef struct
     Function *funct;
 } CallPatch;
 
+#define MAX_CALL_PATCHES 128
+#define MAX_FUNCTION_UNITS 128
+
 typedef struct
 {
     const char *source_text;
     Program *apm;
 
+    Unit *first_unit;
     Unit *last_unit;
 
     // TODO: Make this a dynamically sized array
-    CallPatch call_patch[128];
+    CallPatch call_patch[MAX_CALL_PATCHES];
     size_t call_patch_count;
 
     // TODO: Make this a dynamically sized array
-    FunctionUnit function_unit[128];
+    FunctionUnit function_unit[MAX_FUNCTION_UNITS];
     size_t function_unit_count;
 
     // TODO: Make this a dynamically sized hash map or the like
@@ -54,6 +58,9 @@ typedef struct
 
     TypeData type_data[256];
     size_t type_data_count;
+
+    bool lazy;
+    bool parallel;
 } GlobalAssemblerData;
 
 typedef struct Assembler Assembler;
@@ -82,11 +89,11 @@ void init_assembler_and_create_unit(Assembler *a, Assembler *parent, GlobalAssem
     a->unit = (Unit *)malloc(sizeof(Unit));
     init_unit(a->unit);
 
+    // Units inherit their parent's data, unless given their own
     a->parent = parent;
     if (parent)
     {
-        assert(data == NULL);
-        a->data = parent->data;
+        a->data = data ? data : parent->data;
         a->unit->nested_in = parent->unit;
     }
     else
@@ -98,6 +105,8 @@ void init_assembler_and_create_unit(Assembler *a, Assembler *parent, GlobalAssem
 
     if (a->data->last_unit)
         a->data->last_unit->next = a->unit;
+    else
+        a->data->first_unit = a->unit;
     a->data->last_unit = a->unit;
 
     a->active_registers = 0;
@@ -133,6 +142,24 @@ void release_register(Assembler *a)
     a->active_registers--;
 }
 
+void set_unit_of_function(Assembler *a, Function *funct, Unit *unit)
+{
+    // Replace the function's stub, if it has one
+    for (size_t i = 0; i < a->data->function_unit_count; i++)
+    {
+        if (a->data->function_unit[i].funct == funct)
+        {
+            a->data->function_unit[i].unit = unit;
+            return;
+        }
+    }
+
+    a->data->function_unit[a->data->function_unit_count++] = (FunctionUnit){
+        .funct = funct,
+        .unit = unit,
+    };
+}
+
 Unit *get_unit_of_function(Assembler *a, Function *funct)
 {
     for (size_t i = 0; i < a->data->function_unit_count; i++)
@@ -222,8 +249,9 @@ void patch_y(Unit *unit, size_t location, uint16_t y)
 
 // ASSEMBLE EXPRESSION //
 
-vm_loc get_register_of_expression(Assembler *a, Expression *expr)
+vm_loc get_register_of_expression(Assembler *a, ExpressionIndex index)
 {
+    Expression *expr = get_expression(a->data->apm, index);
     switch (expr->kind)
     {
     case IDENTITY_LITERAL:
@@ -254,13 +282,14 @@ void assemble_default_value(Assembler *a, RhinoType ty, vm_loc loc)
     Unit *unit = a->unit;
     Program *apm = a->data->apm;
 
-    if (ty.is_noneable)
+    TypeInfo *info = get_type_info(apm, ty);
+    if (info->is_noneable)
     {
         emit_load_none(unit, loc.up, loc.reg);
         return;
     }
 
-    switch (ty.tag)
+    switch (info->tag)
     {
     case RHINO_NATIVE_TYPE:
         if (IS_BOOL_TYPE(ty))
@@ -272,7 +301,7 @@ void assemble_default_value(Assembler *a, RhinoType ty, vm_loc loc)
         // else if (IS_STR_TYPE(ty))
         else
         {
-            fatal_error("Could not assemble default value for value of native type %s.", ty.native_type->name);
+            fatal_error("Could not assemble default value for value of native type %s.", info->native_type->name);
         }
 
         break;
@@ -282,7 +311,7 @@ void assemble_default_value(Assembler *a, RhinoType ty, vm_loc loc)
 
     case RHINO_STRUCT_TYPE:
     {
-        StructType *struct_type = ty.struct_type;
+        StructType *struct_type = info->struct_type;
         emit_new_struct(unit, loc.up, loc.reg, struct_type->properties.count);
 
         assert(loc.up == 0); // FIXME: Make this not necessary
@@ -311,13 +340,14 @@ void assemble_default_value(Assembler *a, RhinoType ty, vm_loc loc)
 
 // TODO: `assemble_expression_for_reading` is just a first idea about how to generate more efficient byte code for expressions.
 //       It might be that is idea doesn't last! Is there something better?
-void assemble_expression(Assembler *a, Expression *expr, vm_loc dst);
-vm_loc assemble_expression_for_reading(Assembler *a, Expression *expr);
+void assemble_expression(Assembler *a, ExpressionIndex index, vm_loc dst);
+vm_loc assemble_expression_for_reading(Assembler *a, ExpressionIndex index);
 
-void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
+void assemble_expression(Assembler *a, ExpressionIndex index, vm_loc dst)
 {
     Unit *unit = a->unit;
     Program *apm = a->data->apm;
+    Expression *expr = get_expression(apm, index);
 
     switch (expr->kind)
     {
@@ -376,13 +406,14 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
 
     case FUNCTION_CALL:
     {
-        if (expr->callee->kind != FUNCTION_REFERENCE)
-            fatal_error("Could not assemble CALL expression whose callee is a %s.", expression_kind_string(expr->callee->kind));
+        Expression *callee = get_expression(apm, expr->callee);
+        if (callee->kind != FUNCTION_REFERENCE)
+            fatal_error("Could not assemble CALL expression whose callee is a %s.", expression_kind_string(callee->kind));
 
         vm_reg first_arg_reg = a->active_registers;
-        for (size_t i = 0; i < expr->arguments.count; i++)
+        for (size_t i = 0; i < expr->argument_count; i++)
         {
-            Expression *arg = get_argument(&expr->arguments, i)->expr;
+            ExpressionIndex arg = get_argument(apm, index, i);
             vm_reg arg_reg = reserve_register(a);
             assemble_expression(a, arg, local(arg_reg));
         }
@@ -391,13 +422,13 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
 
         size_t call_ins = emit_call(unit, dst.up, dst.reg, first_arg_reg, 0X0);
 
-        for (size_t i = 0; i < expr->arguments.count; i++)
+        for (size_t i = 0; i < expr->argument_count; i++)
             release_register(a);
 
         a->data->call_patch[a->data->call_patch_count++] = (CallPatch){
             .unit = unit,
             .instruction = call_ins + 1,
-            .funct = expr->callee->function,
+            .funct = callee->function,
         };
 
         break;
@@ -405,21 +436,17 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
 
     case INDEX_BY_FIELD:
     {
-        RhinoType subject_type = get_expression_type(apm, a->data->source_text, expr->subject);
-        assert(subject_type.tag == RHINO_STRUCT_TYPE);
-        StructType *struct_type = subject_type.struct_type;
+        TypeInfo *subject_type = get_type_info(apm, get_expression(apm, expr->subject)->resolved_type);
+        assert(subject_type->tag == RHINO_STRUCT_TYPE);
+        StructType *struct_type = subject_type->struct_type;
 
         vm_loc subject = assemble_expression_for_reading(a, expr->subject);
 
-        Property *field;
-        Iterator it = create_iterator(&struct_type->properties);
-        size_t field_index = 0;
-        while (field = advance_iterator_of(&it, Property))
-        {
-            if (substr_match(a->data->source_text, expr->field, field->identity))
-                break;
-            field_index++;
-        }
+        // Properties are stored contiguously, so the field's slot is its position in the list
+        Expression *field_reference = get_expression(apm, expr->field);
+        assert(field_reference->kind == PROPERTY_REFERENCE);
+        Property *field = field_reference->property;
+        size_t field_index = field - struct_type->properties.items;
 
         // FIXME: Account for these situations
         assert(dst.up == 0);
@@ -569,9 +596,10 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
     // TODO: Use `assemble_expression_for_reading` (if this is a good idea??)
     case TYPE_CAST:
     {
-        RhinoType cast_from = get_expression_type(apm, a->data->source_text, expr->cast_expr);
+        RhinoType cast_from = get_expression(apm, expr->cast_expr)->resolved_type;
         RhinoType cast_to = expr->cast_type;
-        if (cast_from.tag == RHINO_NATIVE_TYPE && is_native_type(cast_to, &apm->str_type))
+        TypeInfo *from = get_type_info(apm, cast_from);
+        if (from->tag == RHINO_NATIVE_TYPE && IS_STR_TYPE(cast_to))
         {
             if (dst.up == 0)
             {
@@ -586,9 +614,9 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
                 emit_copy_instructions(a, dst, local(temp));
             }
         }
-        else if (cast_from.tag == RHINO_ENUM_TYPE && is_native_type(cast_to, &apm->str_type))
+        else if (from->tag == RHINO_ENUM_TYPE && IS_STR_TYPE(cast_to))
         {
-            EnumType *enum_type = cast_from.enum_type;
+            EnumType *enum_type = from->enum_type;
             Unit *value_to_str = get_type_data(a, (void *)enum_type).value_to_str;
 
             vm_reg param = dst.reg;
@@ -613,10 +641,11 @@ void assemble_expression(Assembler *a, Expression *expr, vm_loc dst)
 }
 
 // NOTE: Caller should read the value before reserving new registers, as this may overwrite the value being read
-vm_loc assemble_expression_for_reading(Assembler *a, Expression *expr)
+vm_loc assemble_expression_for_reading(Assembler *a, ExpressionIndex index)
 {
     Unit *unit = a->unit;
     Program *apm = a->data->apm;
+    Expression *expr = get_expression(apm, index);
     a->value_in_unreserved_reg = false;
 
     switch (expr->kind)
@@ -633,7 +662,7 @@ vm_loc assemble_expression_for_reading(Assembler *a, Expression *expr)
     default:
     {
         vm_reg tmp = reserve_register(a);
-        assemble_expression(a, expr, local(tmp));
+        assemble_expression(a, index, local(tmp));
         release_register(a);
         a->value_in_unreserved_reg = true;
         return local(tmp);
@@ -656,6 +685,15 @@ void assemble_enum_types(Assembler *parent, Block *block)
 
         EnumType *enum_type = stmt->enum_type;
 
+        // Assign an int value to each enum
+        size_t first_id = d->enum_int_count;
+        for (size_t i = 0; i < enum_type->values.count; i++)
+            d->enum_int[d->enum_int_count++] = get_enum_value(&enum_type->values, i);
+
+        // Enum types that are never used do not need a value to string unit
+        if (!enum_type->is_reachable)
+            continue;
+
         Assembler value_to_str;
         init_assembler_and_create_unit(&value_to_str, parent, NULL);
         value_to_str.unit->parameter_count = 1;
@@ -669,10 +707,8 @@ void assemble_enum_types(Assembler *parent, Block *block)
 
         for (size_t i = 0; i < enum_type->values.count; i++)
         {
-            // Assign an int value to each enum
-            size_t id = d->enum_int_count++;
-            EnumValue *enum_value = get_enum_value(&enum_type->values, i);
-            d->enum_int[id] = enum_value;
+            size_t id = first_id + i;
+            EnumValue *enum_value = d->enum_int[id];
 
             // Add to value to string unit
             emit_load_enum(value_to_str.unit, 0, condition_reg, id);
@@ -694,12 +730,13 @@ void assemble_enum_types(Assembler *parent, Block *block)
 // ASSEMBLE PROGRAM //
 
 void assemble_code_block(Assembler *a, Block *block);
-void assemble_function(Assembler *parent, Function *funct);
+void assemble_function(Assembler *parent, GlobalAssemblerData *data, Function *funct);
 
 void assemble_code_block(Assembler *a, Block *block)
 {
     assert(!block->declaration_block);
     Unit *unit = a->unit;
+    Program *apm = a->data->apm;
 
     Statement *stmt;
     Iterator it;
@@ -784,7 +821,7 @@ void assemble_code_block(Assembler *a, Block *block)
         case FOR_LOOP:
         {
             Variable *iterator = stmt->iterator;
-            Expression *iterable = stmt->iterable;
+            Expression *iterable = get_expression(a->data->apm, stmt->iterable);
 
             // FIXME: Can the two jumps in this loop be combined into one?
             if (iterable->kind == RANGE_LITERAL)
@@ -821,9 +858,9 @@ void assemble_code_block(Assembler *a, Block *block)
             }
 
             // TODO: Make this an actual loop rather than duplicating the body of the loop for each enum
-            if (iterable->kind == TYPE_REFERENCE && iterable->type.tag == RHINO_ENUM_TYPE)
+            if (iterable->kind == TYPE_REFERENCE && get_type_info(apm, iterable->type)->tag == RHINO_ENUM_TYPE)
             {
-                EnumType *enum_type = iterable->type.enum_type;
+                EnumType *enum_type = get_type_info(apm, iterable->type)->enum_type;
 
                 vm_reg iterator_reg = reserve_register_for_node(a, (void *)iterator);
                 for (size_t i = 0; i < enum_type->values.count; i++)
@@ -937,23 +974,20 @@ void assemble_code_block(Assembler *a, Block *block)
     it = create_iterator(&block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
     {
-        if (stmt->kind == FUNCTION_DECLARATION)
-            assemble_function(a, stmt->function);
+        if (stmt->kind == FUNCTION_DECLARATION && stmt->function->is_reachable)
+            assemble_function(a, NULL, stmt->function);
     }
 
     // Release representations for enum values
     a->data->enum_int_count = initial_enum_int_count;
 }
 
-void assemble_function(Assembler *parent, Function *funct)
+// NOTE: The function is assembled using its parent's data, unless `data` is given
+void assemble_function(Assembler *parent, GlobalAssemblerData *data, Function *funct)
 {
     Assembler a;
-    init_assembler_and_create_unit(&a, parent, NULL);
-
-    a.data->function_unit[a.data->function_unit_count++] = (FunctionUnit){
-        .funct = funct,
-        .unit = a.unit,
-    };
+    init_assembler_and_create_unit(&a, parent, data);
+    set_unit_of_function(&a, funct, a.unit);
 
     a.unit->parameter_count = funct->parameters.count;
 
@@ -966,6 +1000,162 @@ void assemble_function(Assembler *parent, Function *funct)
     assemble_code_block(&a, funct->body);
 }
 
+// LAZY ASSEMBLY //
+// When assembling lazily, global functions are only assembled the first time they are called.
+// Until then, calls to the function are made to a stub unit, which is linked to the assembled
+// unit by the interpreter when it is first called.
+
+typedef struct
+{
+    Assembler *init_assembler;
+    Function *funct;
+} LazyFunction;
+
+// NOTE: Stubs and their lazy functions are owned by the byte code, which frees them
+void create_function_stub(Assembler *a, ByteCode *bc, Function *funct)
+{
+    LazyFunction *lazy = (LazyFunction *)malloc(sizeof(LazyFunction));
+    lazy->init_assembler = a;
+    lazy->funct = funct;
+
+    Unit *stub = (Unit *)malloc(sizeof(Unit));
+    init_unit(stub);
+    stub->parameter_count = funct->parameters.count;
+    stub->lazy_function = (void *)lazy;
+    stub->next = bc->stubs;
+    bc->stubs = stub;
+
+    set_unit_of_function(a, funct, stub);
+}
+
+void link_call_patches(Assembler *a)
+{
+    for (size_t i = 0; i < a->data->call_patch_count; i++)
+    {
+        CallPatch patch = a->data->call_patch[i];
+        patch_unit_ptr_payload(patch.unit, patch.instruction, get_unit_of_function(a, patch.funct));
+    }
+    a->data->call_patch_count = 0;
+}
+
+Unit *link_stub(Unit *stub, Unit *caller, size_t payload)
+{
+    assert(stub->lazy_function);
+
+    if (!stub->assembled)
+    {
+        LazyFunction *lazy = (LazyFunction *)stub->lazy_function;
+        Assembler *a = lazy->init_assembler;
+
+        assemble_function(a, NULL, lazy->funct);
+        link_call_patches(a);
+
+        stub->assembled = get_unit_of_function(a, lazy->funct);
+    }
+
+    patch_unit_ptr_payload(caller, payload, stub->assembled);
+    return stub->assembled;
+}
+
+// PARALLEL ASSEMBLY //
+// Each worker assembles global functions into its own copy of the global data. The units, function units and
+// call patches of each job are recorded, and merged in source order once every job has finished, so the byte code
+// is the same as when the functions are assembled one after another.
+
+typedef struct
+{
+    size_t worker;
+    Unit *first_unit;
+    Unit *last_unit;
+    size_t first_call_patch;
+    size_t call_patch_count;
+    size_t first_function_unit;
+    size_t function_unit_count;
+} FunctionJob;
+
+typedef struct
+{
+    Assembler *init_assembler;
+    Function **functions;
+    GlobalAssemblerData *worker_data;
+    FunctionJob *function_jobs;
+} GlobalFunctionJobs;
+
+void assemble_global_function_job(void *context, size_t worker, size_t job)
+{
+    GlobalFunctionJobs *jobs = (GlobalFunctionJobs *)context;
+    GlobalAssemblerData *data = &jobs->worker_data[worker];
+
+    // Each job starts its own chain of units, but patches and function units accumulate in the worker's data
+    data->first_unit = NULL;
+    data->last_unit = NULL;
+    size_t first_call_patch = data->call_patch_count;
+    size_t first_function_unit = data->function_unit_count;
+
+    assemble_function(jobs->init_assembler, data, jobs->functions[job]);
+
+    jobs->function_jobs[job] = (FunctionJob){
+        .worker = worker,
+        .first_unit = data->first_unit,
+        .last_unit = data->last_unit,
+        .first_call_patch = first_call_patch,
+        .call_patch_count = data->call_patch_count - first_call_patch,
+        .first_function_unit = first_function_unit,
+        .function_unit_count = data->function_unit_count - first_function_unit,
+    };
+}
+
+void assemble_global_functions_in_parallel(Assembler *a, Function **functions, size_t function_count)
+{
+    GlobalAssemblerData *data = a->data;
+    if (function_count == 0)
+        return;
+
+    size_t worker_count = get_processor_count();
+    if (worker_count > function_count)
+        worker_count = function_count;
+
+    GlobalFunctionJobs jobs = {
+        .init_assembler = a,
+        .functions = functions,
+        .worker_data = (GlobalAssemblerData *)malloc(sizeof(GlobalAssemblerData) * worker_count),
+        .function_jobs = (FunctionJob *)malloc(sizeof(FunctionJob) * function_count),
+    };
+
+    // Workers can read the enum values and type data of the global scope, but start with nothing else
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        GlobalAssemblerData *worker_data = &jobs.worker_data[i];
+        *worker_data = *data;
+        worker_data->call_patch_count = 0;
+        worker_data->function_unit_count = 0;
+    }
+
+    run_in_parallel(function_count, worker_count, assemble_global_function_job, (void *)&jobs);
+
+    for (size_t i = 0; i < function_count; i++)
+    {
+        FunctionJob job = jobs.function_jobs[i];
+        GlobalAssemblerData *worker_data = &jobs.worker_data[job.worker];
+
+        data->last_unit->next = job.first_unit;
+        data->last_unit = job.last_unit;
+
+        assert(data->call_patch_count + job.call_patch_count <= MAX_CALL_PATCHES);
+        memcpy(data->call_patch + data->call_patch_count, worker_data->call_patch + job.first_call_patch, sizeof(CallPatch) * job.call_patch_count);
+        data->call_patch_count += job.call_patch_count;
+
+        assert(data->function_unit_count + job.function_unit_count <= MAX_FUNCTION_UNITS);
+        memcpy(data->function_unit + data->function_unit_count, worker_data->function_unit + job.first_function_unit, sizeof(FunctionUnit) * job.function_unit_count);
+        data->function_unit_count += job.function_unit_count;
+    }
+
+    free(jobs.worker_data);
+    free(jobs.function_jobs);
+}
+
+// ASSEMBLE PROGRAM //
+
 void assemble_program(Assembler *a, ByteCode *bc, Program *apm)
 {
     Unit *unit = a->unit;
@@ -975,69 +1165,92 @@ void assemble_program(Assembler *a, ByteCode *bc, Program *apm)
     // Create representations for enum values
     assemble_enum_types(a, apm->program_block);
 
-    // Initialise global variables in the init unit
-    for (size_t i = 0; i <= apm->program_block->max_var_order; i++)
+    // Initialise global variables in the init unit, in the order given by the resolver
+    for (size_t i = 0; i < apm->program_block->initialiser_count; i++)
     {
-        it = create_iterator(&apm->program_block->statements);
-        while (stmt = advance_iterator_of(&it, Statement))
-        {
-            if (stmt->kind != VARIABLE_DECLARATION)
-                continue;
-
-            if (stmt->variable->order != i)
-                continue;
-
-            vm_reg variable_reg = reserve_register_for_node(a, (void *)stmt->variable);
+        stmt = apm->program_block->initialisers[i];
+        vm_reg variable_reg = reserve_register_for_node(a, (void *)stmt->variable);
 
-            if (stmt->initial_value)
-                assemble_expression(a, stmt->initial_value, local(variable_reg));
-            else
-                assemble_default_value(a, stmt->variable->type, local(variable_reg));
-        }
+        if (stmt->initial_value)
+            assemble_expression(a, stmt->initial_value, local(variable_reg));
+        else
+            assemble_default_value(a, stmt->variable->type, local(variable_reg));
     }
 
-    // Assemble all functions declared in the global scope
+    // Assemble all reachable functions declared in the global scope
+    size_t function_count = 0;
+    Function **functions = (Function **)malloc(sizeof(Function *) * apm->program_block->statements.count);
+
     it = create_iterator(&apm->program_block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
     {
-        if (stmt->kind == FUNCTION_DECLARATION)
-            assemble_function(a, stmt->function);
+        if (stmt->kind == FUNCTION_DECLARATION && stmt->function->is_reachable)
+            functions[function_count++] = stmt->function;
     }
 
+    if (a->data->lazy)
+    {
+        for (size_t i = 0; i < function_count; i++)
+            create_function_stub(a, bc, functions[i]);
+    }
+    else if (a->data->parallel)
+        assemble_global_functions_in_parallel(a, functions, function_count);
+    else
+    {
+        for (size_t i = 0; i < function_count; i++)
+            assemble_function(a, NULL, functions[i]);
+    }
+    free(functions);
+
     bc->main = get_unit_of_function(a, apm->main);
 
     // Call to main from the init unit
-    emit_run(unit, 0, bc->main);
+    bc->run_main = emit_run(unit, 0, bc->main);
 
     // Patch all function calls
-    for (size_t i = 0; i < a->data->call_patch_count; i++)
-    {
-        CallPatch patch = a->data->call_patch[i];
-        patch_unit_ptr_payload(patch.unit, patch.instruction, get_unit_of_function(a, patch.funct));
-    }
+    link_call_patches(a);
 }
 
 // ASSEMBLE //
 
-void assemble(Compiler *compiler, Program *apm, ByteCode *byte_code)
+// The init assembler, along with the data used by all unit assemblers
+typedef struct
 {
-    // Data used by all unit assemblers
+    Assembler assembler;
     GlobalAssemblerData data;
+} InitAssembler;
+
+void assemble(Compiler *compiler, Program *apm, ByteCode *byte_code, bool lazy)
+{
+    InitAssembler *init = (InitAssembler *)malloc(sizeof(InitAssembler));
+
+    // Data used by all unit assemblers
+    GlobalAssemblerData *data = &init->data;
+
+    data->apm = apm;
+    data->source_text = compiler->source_text;
 
-    data.apm = apm;
-    data.source_text = compiler->source_text;
+    data->first_unit = NULL;
+    data->last_unit = NULL;
 
-    data.last_unit = NULL;
+    data->call_patch_count = 0;
+    data->function_unit_count = 0;
+    data->enum_int_count = 0;
+    data->type_data_count = 0;
 
-    data.call_patch_count = 0;
-    data.function_unit_count = 0;
-    data.enum_int_count = 0;
-    data.type_data_count = 0;
+    data->lazy = lazy;
+    data->parallel = compiler->parallel_functions;
 
     // Create init unit
-    Assembler assembler;
-    init_assembler_and_create_unit(&assembler, NULL, &data);
+    Assembler *assembler = &init->assembler;
+    init_assembler_and_create_unit(assembler, NULL, data);
+
+    byte_code->init = assembler->unit;
+    assemble_program(assembler, byte_code, apm);
 
-    byte_code->init = assembler.unit;
-    assemble_program(&assembler, byte_code, apm);
+    // When assembling lazily, the assembler is retained by the byte code so that stubs can be assembled later
+    if (lazy)
+        byte_code->lazy_assembler = (void *)init;
+    else
+        free(init);
 }
\ No newline at end of file
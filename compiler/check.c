@@ -3,7 +3,8 @@
 void check_block(Compiler *c, Program *apm, Block *block);
 void check_function(Compiler *c, Program *apm, Function *funct);
 void check_statement_list(Compiler *c, Program *apm, StatementList *statement_list);
-void check_expression(Compiler *c, Program *apm, Expression *expr);
+void check_statement(Compiler *c, Program *apm, Statement *stmt);
+void check_expression(Compiler *c, Program *apm, ExpressionIndex index);
 
 void check_block(Compiler *c, Program *apm, Block *block)
 {
@@ -18,7 +19,8 @@ void check_block(Compiler *c, Program *apm, Block *block)
 
 void check_function(Compiler *c, Program *apm, Function *funct)
 {
-    check_block(c, apm, funct->body);
+    if (funct->body)
+        check_block(c, apm, funct->body);
 }
 
 void check_statement_list(Compiler *c, Program *apm, StatementList *statement_list)
@@ -26,125 +28,129 @@ void check_statement_list(Compiler *c, Program *apm, StatementList *statement_li
     Statement *stmt;
     Iterator it = create_iterator(statement_list);
     while (stmt = advance_iterator_of(&it, Statement))
+        check_statement(c, apm, stmt);
+}
+
+void check_statement(Compiler *c, Program *apm, Statement *stmt)
+{
+    switch (stmt->kind)
     {
-        switch (stmt->kind)
-        {
 
-        case INVALID_STATEMENT:
-            break;
+    case INVALID_STATEMENT:
+        break;
 
-        case VARIABLE_DECLARATION:
-        {
-            if (!stmt->initial_value)
-                continue;
+    case VARIABLE_DECLARATION:
+    {
+        if (!stmt->initial_value)
+            break;
 
-            check_expression(c, apm, stmt->initial_value);
+        check_expression(c, apm, stmt->initial_value);
 
-            // Check initial value of variable declaration matches the variable's type
-            RhinoType var_type = stmt->variable->type;
-            RhinoType value_type = get_expression_type(apm, c->source_text, stmt->initial_value);
+        // Check initial value of variable declaration matches the variable's type
+        RhinoType var_type = stmt->variable->type;
+        RhinoType value_type = get_expression(apm, stmt->initial_value)->resolved_type;
 
-            if (!allow_assign_a_to_b(apm, value_type, var_type))
-                raise_compilation_error(c, RHS_TYPE_DOES_NOT_MATCH_LHS, stmt->span);
+        if (!allow_assign_a_to_b(apm, value_type, var_type))
+            raise_compilation_error(c, RHS_TYPE_DOES_NOT_MATCH_LHS, stmt->span);
 
-            break;
-        }
+        break;
+    }
 
-        case FUNCTION_DECLARATION:
-        {
-            check_function(c, apm, stmt->function);
-            break;
-        }
+    case FUNCTION_DECLARATION:
+    {
+        check_function(c, apm, stmt->function);
+        break;
+    }
 
-        case ENUM_TYPE_DECLARATION:
-            break;
+    case ENUM_TYPE_DECLARATION:
+        break;
 
-        case STRUCT_TYPE_DECLARATION:
-            // TODO: How to correctly check structs declarations?
-            break;
+    case STRUCT_TYPE_DECLARATION:
+        // TODO: How to correctly check structs declarations?
+        break;
 
-        case CODE_BLOCK:
-        {
-            check_block(c, apm, stmt->block);
-            break;
-        }
+    case CODE_BLOCK:
+    {
+        check_block(c, apm, stmt->block);
+        break;
+    }
 
-        case IF_SEGMENT:
-        case ELSE_IF_SEGMENT:
-        {
-            check_expression(c, apm, stmt->condition);
-            check_block(c, apm, stmt->body);
+    case IF_SEGMENT:
+    case ELSE_IF_SEGMENT:
+    {
+        check_expression(c, apm, stmt->condition);
+        check_block(c, apm, stmt->body);
 
-            // Check if statement conditions are booleans
-            RhinoType condition_type = get_expression_type(apm, c->source_text, stmt->condition);
-            if (IS_VALID_TYPE(condition_type) && !IS_BOOL_TYPE(condition_type) && !condition_type.is_noneable)
-                raise_compilation_error(c, CONDITION_IS_NOT_BOOLEAN, stmt->condition->span);
+        // Check if statement conditions are booleans
+        RhinoType condition_type = get_expression(apm, stmt->condition)->resolved_type;
+        if (IS_VALID_TYPE(condition_type) && !IS_BOOL_TYPE(condition_type) && !get_type_info(apm, condition_type)->is_noneable)
+            raise_compilation_error(c, CONDITION_IS_NOT_BOOLEAN, *get_expression_span(apm, stmt->condition));
 
-            break;
-        }
+        break;
+    }
 
-        case ELSE_SEGMENT:
-            check_block(c, apm, stmt->body);
-            break;
+    case ELSE_SEGMENT:
+        check_block(c, apm, stmt->body);
+        break;
 
-        case BREAK_LOOP:
-            check_block(c, apm, stmt->body);
-            break;
+    case BREAK_LOOP:
+        check_block(c, apm, stmt->body);
+        break;
 
-        case FOR_LOOP:
-            check_expression(c, apm, stmt->iterable);
-            check_block(c, apm, stmt->body);
-            break;
+    case FOR_LOOP:
+        check_expression(c, apm, stmt->iterable);
+        check_block(c, apm, stmt->body);
+        break;
 
-        case WHILE_LOOP:
-        {
-            check_expression(c, apm, stmt->condition);
-            check_block(c, apm, stmt->body);
+    case WHILE_LOOP:
+    {
+        check_expression(c, apm, stmt->condition);
+        check_block(c, apm, stmt->body);
 
-            // Check condition is boolean
-            RhinoType condition_type = get_expression_type(apm, c->source_text, stmt->condition);
-            if (IS_VALID_TYPE(condition_type) && !IS_BOOL_TYPE(condition_type) && !condition_type.is_noneable)
-                raise_compilation_error(c, CONDITION_IS_NOT_BOOLEAN, stmt->condition->span);
+        // Check condition is boolean
+        RhinoType condition_type = get_expression(apm, stmt->condition)->resolved_type;
+        if (IS_VALID_TYPE(condition_type) && !IS_BOOL_TYPE(condition_type) && !get_type_info(apm, condition_type)->is_noneable)
+            raise_compilation_error(c, CONDITION_IS_NOT_BOOLEAN, *get_expression_span(apm, stmt->condition));
 
-            break;
-        }
+        break;
+    }
 
-        case BREAK_STATEMENT:
-            break;
+    case BREAK_STATEMENT:
+        break;
 
-        case ASSIGNMENT_STATEMENT:
-        {
-            check_expression(c, apm, stmt->assignment_lhs);
-            check_expression(c, apm, stmt->assignment_rhs);
+    case ASSIGNMENT_STATEMENT:
+    {
+        check_expression(c, apm, stmt->assignment_lhs);
+        check_expression(c, apm, stmt->assignment_rhs);
 
-            // Check rhs of assignment is a type that can be assigned to the lhs
-            RhinoType lhs_type = get_expression_type(apm, c->source_text, stmt->assignment_lhs);
-            RhinoType rhs_type = get_expression_type(apm, c->source_text, stmt->assignment_rhs);
+        // Check rhs of assignment is a type that can be assigned to the lhs
+        RhinoType lhs_type = get_expression(apm, stmt->assignment_lhs)->resolved_type;
+        RhinoType rhs_type = get_expression(apm, stmt->assignment_rhs)->resolved_type;
 
-            if (!allow_assign_a_to_b(apm, rhs_type, lhs_type))
-                raise_compilation_error(c, RHS_TYPE_DOES_NOT_MATCH_LHS, stmt->span);
+        if (!allow_assign_a_to_b(apm, rhs_type, lhs_type))
+            raise_compilation_error(c, RHS_TYPE_DOES_NOT_MATCH_LHS, stmt->span);
 
-            break;
-        }
+        break;
+    }
 
-        case OUTPUT_STATEMENT:
-        case EXPRESSION_STMT:
-        case RETURN_STATEMENT:
-        {
-            if (stmt->expression)
-                check_expression(c, apm, stmt->expression);
-            break;
-        }
+    case OUTPUT_STATEMENT:
+    case EXPRESSION_STMT:
+    case RETURN_STATEMENT:
+    {
+        if (stmt->expression)
+            check_expression(c, apm, stmt->expression);
+        break;
+    }
 
-        default:
-            fatal_error("Could not check %s statement", statement_kind_string(stmt->kind));
-            break;
-        }
+    default:
+        fatal_error("Could not check %s statement", statement_kind_string(stmt->kind));
+        break;
     }
 }
 
-void check_expression(Compiler *c, Program *apm, Expression *expr)
+void check_expression(Compiler *c, Program *apm, ExpressionIndex index)
 {
+    Expression *expr = get_expression(apm, index);
     switch (expr->kind)
     {
     case INVALID_EXPRESSION:
@@ -154,7 +160,7 @@ void check_expression(Compiler *c, Program *apm, Expression *expr)
     {
         if (!expr->given_error)
         {
-            raise_compilation_error(c, IDENTITY_DOES_NOT_EXIST, expr->span);
+            raise_compilation_error(c, IDENTITY_DOES_NOT_EXIST, *get_expression_span(apm, index));
             expr->given_error = true;
         }
         break;
@@ -178,10 +184,8 @@ void check_expression(Compiler *c, Program *apm, Expression *expr)
     {
         check_expression(c, apm, expr->callee);
 
-        Argument *arg;
-        Iterator it = create_iterator(&expr->arguments);
-        while (arg = advance_iterator_of(&it, Argument))
-            check_expression(c, apm, arg->expr);
+        for (size_t i = 0; i < expr->argument_count; i++)
+            check_expression(c, apm, get_argument(apm, index, i));
 
         break;
     }
@@ -233,7 +237,14 @@ void check_expression(Compiler *c, Program *apm, Expression *expr)
 
 // CHECK //
 
+void check_declaration(Compiler *c, void *context, size_t i)
+{
+    Program *apm = (Program *)context;
+    check_statement(c, apm, get_statement(&apm->program_block->statements, i));
+}
+
 void check(Compiler *c, Program *apm)
 {
-    check_block(c, apm, apm->program_block);
+    // The program block is never a singleton block, so each declaration can be checked in parallel
+    run_compiler_jobs(c, apm->program_block->statements.count, check_declaration, (void *)apm);
 }
\ No newline at end of file
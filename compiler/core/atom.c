@@ -0,0 +1,101 @@
+#include "atom.h"
+
+// ATOM TABLE //
+
+#define INITIAL_ATOM_CAPACITY 256
+
+uint32_t hash_atom_string(const char *str, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void init_atom_table(AtomTable *atoms)
+{
+    atoms->capacity = INITIAL_ATOM_CAPACITY;
+    atoms->str = (const char **)malloc(sizeof(const char *) * atoms->capacity);
+    atoms->len = (uint32_t *)malloc(sizeof(uint32_t) * atoms->capacity);
+    atoms->hash = (uint32_t *)malloc(sizeof(uint32_t) * atoms->capacity);
+
+    atoms->slot_capacity = INITIAL_ATOM_CAPACITY * 2;
+    atoms->slot = (Atom *)calloc(atoms->slot_capacity, sizeof(Atom));
+
+    // NO_ATOM
+    atoms->str[0] = "";
+    atoms->len[0] = 0;
+    atoms->hash[0] = 0;
+    atoms->count = 1;
+
+    // Builtin atoms are interned in order, so that they have the values given in LIST_BUILTIN_ATOMS
+#define INTERN_BUILTIN_ATOM(name, str) intern_atom(atoms, str, strlen(str));
+    LIST_BUILTIN_ATOMS(INTERN_BUILTIN_ATOM)
+#undef INTERN_BUILTIN_ATOM
+}
+
+void free_atom_table(AtomTable *atoms)
+{
+    free(atoms->str);
+    free(atoms->len);
+    free(atoms->hash);
+    free(atoms->slot);
+}
+
+void grow_atom_slots(AtomTable *atoms)
+{
+    size_t slot_capacity = atoms->slot_capacity * 2;
+    Atom *slot = (Atom *)calloc(slot_capacity, sizeof(Atom));
+
+    for (Atom atom = 1; atom < atoms->count; atom++)
+    {
+        size_t i = atoms->hash[atom] & (slot_capacity - 1);
+        while (slot[i] != NO_ATOM)
+            i = (i + 1) & (slot_capacity - 1);
+        slot[i] = atom;
+    }
+
+    free(atoms->slot);
+    atoms->slot = slot;
+    atoms->slot_capacity = slot_capacity;
+}
+
+Atom intern_atom(AtomTable *atoms, const char *str, size_t len)
+{
+    uint32_t hash = hash_atom_string(str, len);
+
+    // Find existing atom
+    size_t i = hash & (atoms->slot_capacity - 1);
+    while (atoms->slot[i] != NO_ATOM)
+    {
+        Atom atom = atoms->slot[i];
+        if (atoms->hash[atom] == hash && atoms->len[atom] == len && memcmp(atoms->str[atom], str, len) == 0)
+            return atom;
+        i = (i + 1) & (atoms->slot_capacity - 1);
+    }
+
+    // Create new atom
+    if (atoms->count == atoms->capacity)
+    {
+        atoms->capacity *= 2;
+        atoms->str = (const char **)realloc(atoms->str, sizeof(const char *) * atoms->capacity);
+        atoms->len = (uint32_t *)realloc(atoms->len, sizeof(uint32_t) * atoms->capacity);
+        atoms->hash = (uint32_t *)realloc(atoms->hash, sizeof(uint32_t) * atoms->capacity);
+    }
+
+    Atom atom = (Atom)atoms->count++;
+    atoms->str[atom] = str;
+    atoms->len[atom] = (uint32_t)len;
+    atoms->hash[atom] = hash;
+    atoms->slot[i] = atom;
+
+    // Keep the load factor of the hash table at or below one half
+    if (atoms->count * 2 > atoms->slot_capacity)
+        grow_atom_slots(atoms);
+
+    return atom;
+}
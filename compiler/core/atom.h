@@ -0,0 +1,48 @@
+#ifndef ATOM_H
+#define ATOM_H
+
+#include "libs.h"
+
+// ATOMS //
+// Identifiers are interned into an atom table, so that identifiers can be compared by
+// comparing their atoms, rather than comparing the text of the identifiers.
+
+typedef uint32_t Atom;
+
+#define LIST_BUILTIN_ATOMS(MACRO) \
+    MACRO(ATOM_BOOL, "bool")      \
+    MACRO(ATOM_INT, "int")        \
+    MACRO(ATOM_NUM, "num")        \
+    MACRO(ATOM_STR, "str")        \
+    MACRO(ATOM_MAIN, "main")
+
+#define BUILTIN_ATOM_ENUM_VALUE(name, str) name,
+enum
+{
+    NO_ATOM,
+    LIST_BUILTIN_ATOMS(BUILTIN_ATOM_ENUM_VALUE)
+    BUILTIN_ATOM_COUNT
+};
+#undef BUILTIN_ATOM_ENUM_VALUE
+
+// ATOM TABLE //
+
+typedef struct
+{
+    // Indexed by atom
+    const char **str; // NOTE: Points into the source text, which must outlive the table
+    uint32_t *len;
+    uint32_t *hash;
+    size_t count;
+    size_t capacity;
+
+    // Open addressed hash table of atoms, where NO_ATOM marks an empty slot
+    Atom *slot;
+    size_t slot_capacity; // Always a power of two
+} AtomTable;
+
+void init_atom_table(AtomTable *atoms);
+void free_atom_table(AtomTable *atoms);
+Atom intern_atom(AtomTable *atoms, const char *str, size_t len);
+
+#endif
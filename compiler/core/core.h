@@ -1,11 +1,15 @@
 #ifndef CORE_H
 #define CORE_H
 
+#include "atom.h"
 #include "fatal_error.h"
 #include "libs.h"
 #include "memory.h"
 #include "run_on_string.h"
+#include "source_file.h"
+#include "source_map.h"
 #include "substr.h"
+#include "threads.h"
 
 // UNREACHABLE //
 
@@ -1,10 +1,61 @@
 #include "memory.h"
+#include "threads.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 #define ALIGN_UP(ptr, align) (uint8_t *)((uintptr_t)(ptr) + ((align) - 1) & ~(align - 1))
 
 // ALLOCATORS //
 
-Bucket *next_available_bucket = NULL;
+// Each thread keeps its own pool of free buckets, so independent compilations can run on separate threads
+// NOTE: Buckets released on a thread join that thread's pool, whichever thread acquired them
+thread_local Bucket *next_available_bucket = NULL;
+
+// Threads return their pools here when they finish, and refill their pools from here before allocating
+Mutex shared_bucket_lock = MUTEX_INIT;
+Bucket *shared_buckets = NULL;
+
+void return_thread_buckets()
+{
+    if (!next_available_bucket)
+        return;
+
+    Bucket *last = next_available_bucket;
+    while (last->next)
+        last = last->next;
+
+    lock_mutex(&shared_bucket_lock);
+    last->next = shared_buckets;
+    shared_buckets = next_available_bucket;
+    unlock_mutex(&shared_bucket_lock);
+
+    next_available_bucket = NULL;
+}
+
+// Take up to a block's worth of buckets from the shared pool, returning false if it is empty
+bool take_shared_buckets()
+{
+    lock_mutex(&shared_bucket_lock);
+
+    Bucket *first = shared_buckets;
+    if (first)
+    {
+        Bucket *last = first;
+        for (size_t i = 1; i < BUCKETS_PER_BLOCK && last->next; i++)
+            last = last->next;
+
+        shared_buckets = last->next;
+        last->next = NULL;
+        next_available_bucket = first;
+    }
+
+    unlock_mutex(&shared_bucket_lock);
+    return first != NULL;
+}
 
 void allocate_buckets()
 {
@@ -34,7 +85,7 @@ void allocate_buckets()
 Bucket *acquire_bucket()
 {
     Bucket *bucket;
-    if (!next_available_bucket)
+    if (!next_available_bucket && !take_shared_buckets())
         allocate_buckets();
 
     bucket = next_available_bucket;
@@ -45,6 +96,66 @@ Bucket *acquire_bucket()
     return bucket;
 }
 
+// Big buckets are mapped directly, so that they are returned to the OS once released
+void *map_bucket_memory(size_t size)
+{
+#ifdef _WIN32
+    void *memory = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    assert(memory);
+#else
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(memory != MAP_FAILED);
+#ifdef MADV_HUGEPAGE
+    madvise(memory, size, MADV_HUGEPAGE); // Only a hint, so failure is fine
+#endif
+#endif
+    return memory;
+}
+
+void unmap_bucket_memory(void *memory, size_t size)
+{
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, size);
+#endif
+}
+
+// Large chunks and arena buckets are allocated individually, rather than taken from the pool
+Bucket *acquire_large_bucket(size_t size)
+{
+    size_t total_size = sizeof(Bucket) + size;
+
+    Bucket *bucket;
+    if (total_size >= MAPPED_BUCKET_THRESHOLD)
+        bucket = (Bucket *)map_bucket_memory(total_size);
+    else
+        bucket = (Bucket *)malloc(total_size);
+    assert(bucket);
+
+    bucket->head = bucket->data;
+    bucket->tail = bucket->data + size;
+    bucket->next = NULL;
+    return bucket;
+}
+
+// NOTE: The size of a large bucket never changes, so it tells us how the bucket was allocated
+void free_large_buckets(Bucket *bucket)
+{
+    while (bucket)
+    {
+        Bucket *next = bucket->next;
+
+        size_t total_size = bucket->tail - (uint8_t *)bucket;
+        if (total_size >= MAPPED_BUCKET_THRESHOLD)
+            unmap_bucket_memory(bucket, total_size);
+        else
+            free(bucket);
+
+        bucket = next;
+    }
+}
+
 void release_bucket(Bucket *bucket)
 {
     Bucket *start_of_chain = next_available_bucket;
@@ -59,14 +170,110 @@ void init_allocator(Allocator *allocator)
 {
     allocator->first = NULL;
     allocator->current = NULL;
+    allocator->large = NULL;
+    allocator->bucket_size = BUCKET_SIZE;
+}
+
+// Arenas hold many chunks of a single kind, so they use larger buckets to keep those chunks densely packed
+void init_arena(Allocator *allocator, size_t bucket_size)
+{
+    assert(bucket_size >= BUCKET_SIZE);
+
+    allocator->first = NULL;
+    allocator->current = NULL;
+    allocator->large = NULL;
+    allocator->bucket_size = bucket_size;
+}
+
+// Forget every chunk, but keep the buckets so that they are reused by later allocations
+// NOTE: Large chunks are freed, as they are unlikely to fit what is allocated next
+void reset_allocator(Allocator *allocator)
+{
+    for (Bucket *bucket = allocator->first; bucket; bucket = bucket->next)
+        bucket->head = bucket->data;
+    allocator->current = allocator->first;
+
+    free_large_buckets(allocator->large);
+    allocator->large = NULL;
+}
+
+// Return every bucket owned by the allocator to the pool, or to the OS if it did not come from the pool
+// NOTE: Any chunks allocated from it must no longer be referenced
+void release_allocator(Allocator *allocator)
+{
+    if (allocator->bucket_size == BUCKET_SIZE)
+    {
+        if (allocator->first)
+            release_bucket(allocator->first);
+    }
+    else
+    {
+        free_large_buckets(allocator->first);
+    }
+
+    free_large_buckets(allocator->large);
+
+    allocator->first = NULL;
+    allocator->current = NULL;
+    allocator->large = NULL;
+}
+
+Bucket *append_buckets(Bucket *chain, Bucket *other)
+{
+    if (!chain)
+        return other;
+
+    Bucket *last = chain;
+    while (last->next)
+        last = last->next;
+    last->next = other;
+    return chain;
+}
+
+// Take ownership of every chunk allocated from `other`, which is left empty
+// NOTE: The buckets are placed before the allocator's own, so its current bucket is unaffected
+void merge_allocator(Allocator *allocator, Allocator *other)
+{
+    assert((allocator->bucket_size == BUCKET_SIZE) == (other->bucket_size == BUCKET_SIZE));
+
+    if (other->first)
+    {
+        allocator->first = append_buckets(other->first, allocator->first);
+        if (!allocator->current)
+            allocator->current = other->current;
+    }
+    allocator->large = append_buckets(other->large, allocator->large);
+
+    other->first = NULL;
+    other->current = NULL;
+    other->large = NULL;
+}
+
+Bucket *acquire_allocator_bucket(Allocator *allocator)
+{
+    if (allocator->bucket_size == BUCKET_SIZE)
+        return acquire_bucket();
+
+    return acquire_large_bucket(allocator->bucket_size - sizeof(Bucket));
 }
 
 void *allocate_chunk(Allocator *allocator, size_t size, size_t align)
 {
+    if (size + align > allocator->bucket_size - sizeof(Bucket))
+    {
+        Bucket *large = acquire_large_bucket(size + align);
+        large->next = allocator->large;
+        allocator->large = large;
+
+        uint8_t *chunk_start = ALIGN_UP(large->head, align);
+        large->head = chunk_start + size;
+        return chunk_start;
+    }
+
     Bucket *bucket = allocator->current;
     if (!bucket)
     {
-        bucket = acquire_bucket();
+        bucket = acquire_allocator_bucket(allocator);
         allocator->first = bucket;
         allocator->current = bucket;
     }
@@ -82,8 +289,17 @@ void *allocate_chunk(Allocator *allocator, size_t size, size_t align)
             return chunk_start;
         }
 
-        Bucket *next = acquire_bucket();
-        if (bucket->tail == (uint8_t *)next)
+        // Buckets kept after a reset are reused before acquiring more
+        if (bucket->next)
+        {
+            bucket = bucket->next;
+            allocator->current = bucket;
+            continue;
+        }
+
+        // Adjacent pool buckets are merged, but arena buckets must stay separate so they can be freed
+        Bucket *next = acquire_allocator_bucket(allocator);
+        if (allocator->bucket_size == BUCKET_SIZE && bucket->tail == (uint8_t *)next)
         {
             bucket->tail = next->tail;
         }
@@ -96,6 +312,44 @@ void *allocate_chunk(Allocator *allocator, size_t size, size_t align)
     }
 }
 
+// STATISTICS //
+
+AllocatorStats get_allocator_stats(Allocator *allocator)
+{
+    AllocatorStats stats = {0, 0, 0, 0};
+
+    for (Bucket *bucket = allocator->first; bucket; bucket = bucket->next)
+    {
+        stats.bucket_count++;
+        stats.reserved += bucket->tail - (uint8_t *)bucket;
+        stats.used += bucket->head - bucket->data;
+    }
+
+    for (Bucket *bucket = allocator->large; bucket; bucket = bucket->next)
+    {
+        stats.large_count++;
+        stats.reserved += bucket->tail - (uint8_t *)bucket;
+        stats.used += bucket->head - bucket->data;
+    }
+
+    return stats;
+}
+
+// NOTE: Includes the shared pool, as well as this thread's pool
+size_t count_available_buckets()
+{
+    size_t count = 0;
+    for (Bucket *bucket = next_available_bucket; bucket; bucket = bucket->next)
+        count++;
+
+    lock_mutex(&shared_bucket_lock);
+    for (Bucket *bucket = shared_buckets; bucket; bucket = bucket->next)
+        count++;
+    unlock_mutex(&shared_bucket_lock);
+
+    return count;
+}
+
 // ITERATORS //
 
 Iterator create_iterator(Bucket *bucket)
@@ -104,18 +358,37 @@ Iterator create_iterator(Bucket *bucket)
         return (Iterator){
             .bucket = NULL,
             .head = NULL,
+            .tail = NULL,
         };
 
     return (Iterator){
         .bucket = bucket,
         .head = bucket->data,
+        .tail = NULL,
+    };
+}
+
+Iterator create_array_iterator(void *items, size_t size)
+{
+    return (Iterator){
+        .bucket = NULL,
+        .head = (uint8_t *)items,
+        .tail = (uint8_t *)items + size,
     };
 }
 
 void *advance_iterator(Iterator *it, size_t size, size_t align)
 {
+    // Arrays are a single contiguous run of chunks
     if (it->bucket == NULL)
-        return NULL;
+    {
+        if ((size_t)(it->tail - it->head) < size)
+            return NULL;
+
+        void *chunk = (void *)it->head;
+        it->head += size;
+        return chunk;
+    }
 
     while (true)
     {
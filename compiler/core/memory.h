@@ -8,6 +8,11 @@
 #define BUCKETS_PER_BLOCK 64
 #define BUCKET_SIZE 128
 
+// Buckets at least this big are mapped directly from the OS, and use huge pages where available
+#ifndef MAPPED_BUCKET_THRESHOLD
+#define MAPPED_BUCKET_THRESHOLD (1024 * 1024)
+#endif
+
 typedef struct Bucket Bucket;
 typedef struct Allocator Allocator;
 
@@ -23,11 +28,29 @@ struct Allocator
 {
     Bucket *first;
     Bucket *current;
+    Bucket *large;      // Chunks too large for a bucket, each given a bucket of its own
+    size_t bucket_size; // Buckets of BUCKET_SIZE come from the shared pool, larger ones are allocated directly
 };
 
-extern Bucket *next_available_bucket;
+typedef struct
+{
+    size_t bucket_count;
+    size_t large_count;
+    size_t reserved; // Bytes held by the allocator, including bucket headers
+    size_t used;     // Bytes given out in chunks, including alignment padding
+} AllocatorStats;
+
+extern thread_local Bucket *next_available_bucket;
 
 void init_allocator(Allocator *allocator);
+void init_arena(Allocator *allocator, size_t bucket_size);
+void reset_allocator(Allocator *allocator);
+void release_allocator(Allocator *allocator);
+void merge_allocator(Allocator *allocator, Allocator *other);
+
+AllocatorStats get_allocator_stats(Allocator *allocator);
+size_t count_available_buckets();
+void return_thread_buckets();
 
 void *allocate_chunk(Allocator *allocator, size_t size, size_t align);
 #define allocate(allocator, T) (T *)allocate_chunk(allocator, sizeof(T), alignof(T))
@@ -40,9 +63,11 @@ struct Iterator
 {
     Bucket *bucket;
     uint8_t *head;
+    uint8_t *tail; // NOTE: Only used when iterating an array, buckets use their own head
 };
 
 Iterator create_iterator(Bucket *bucket);
+Iterator create_array_iterator(void *items, size_t size);
 
 void *advance_iterator(Iterator *it, size_t size, size_t align);
 #define advance_iterator_of(it, T) ((T *)advance_iterator(it, sizeof(T), alignof(T)))
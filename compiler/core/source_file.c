@@ -0,0 +1,188 @@
+#include "source_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// READING //
+// Used for stdin, pipes, and anything else that cannot be mapped
+
+bool read_source_stream(SourceFile *file, FILE *handle)
+{
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *text = (char *)malloc(capacity);
+    if (text == NULL)
+        return false;
+
+    while (true)
+    {
+        if (length + 1 == capacity)
+        {
+            capacity *= 2;
+            char *grown = (char *)realloc(text, capacity);
+            if (grown == NULL)
+            {
+                free(text);
+                return false;
+            }
+            text = grown;
+        }
+
+        size_t count = fread(text + length, 1, capacity - length - 1, handle);
+        if (count == 0)
+            break;
+        length += count;
+    }
+
+    text[length] = '\0';
+
+    file->text = text;
+    file->length = length;
+    file->mapping = NULL;
+    file->mapping_size = 0;
+    return true;
+}
+
+bool read_source_file(SourceFile *file, const char *path)
+{
+    FILE *handle = fopen(path, "rb");
+    if (handle == NULL)
+        return false;
+
+    bool success = read_source_stream(file, handle);
+    fclose(handle);
+    return success;
+}
+
+// MAPPING //
+
+#ifdef _WIN32
+
+bool map_source_file(SourceFile *file, const char *path)
+{
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    // The end of the last page of a view is filled with zeros, which provides the NUL character.
+    // If the file ends exactly on a page boundary there is no padding, so the file is read instead.
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    if (size.QuadPart % info.dwPageSize == 0)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL)
+        return false;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL)
+        return false;
+
+    file->text = (const char *)view;
+    file->length = (size_t)size.QuadPart;
+    file->mapping = view;
+    file->mapping_size = (size_t)size.QuadPart;
+    return true;
+}
+
+void unmap_source_file(SourceFile *file)
+{
+    UnmapViewOfFile(file->mapping);
+}
+
+#else
+
+bool map_source_file(SourceFile *file, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // Reserve an extra page of zeros after the file, then map the file over the start of the reservation.
+    // This provides the NUL character even when the file ends exactly on a page boundary.
+    size_t length = (size_t)info.st_size;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (length + page_size - 1) / page_size * page_size + page_size;
+
+    void *mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (mmap(mapping, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        munmap(mapping, mapping_size);
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+
+    file->text = (const char *)mapping;
+    file->length = length;
+    file->mapping = mapping;
+    file->mapping_size = mapping_size;
+    return true;
+}
+
+void unmap_source_file(SourceFile *file)
+{
+    munmap(file->mapping, file->mapping_size);
+}
+
+#endif
+
+// SOURCE FILES //
+
+// A path of "-" reads the source from stdin
+bool load_source_file(SourceFile *file, const char *path)
+{
+    if (strcmp(path, "-") == 0)
+        return read_source_stream(file, stdin);
+
+    if (map_source_file(file, path))
+        return true;
+
+    return read_source_file(file, path);
+}
+
+void unload_source_file(SourceFile *file)
+{
+    if (file->mapping)
+        unmap_source_file(file);
+    else
+        free((void *)file->text);
+
+    file->text = NULL;
+    file->length = 0;
+    file->mapping = NULL;
+    file->mapping_size = 0;
+}
@@ -0,0 +1,21 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include "libs.h"
+
+// SOURCE FILES //
+// Source files are memory mapped where possible, rather than copied into memory.
+// The text of a source file is always followed by a NUL character.
+
+typedef struct
+{
+    const char *text;
+    size_t length;
+    void *mapping;       // NULL if the text was read into a heap buffer instead
+    size_t mapping_size; // Including the padding after the end of the file
+} SourceFile;
+
+bool load_source_file(SourceFile *file, const char *path);
+void unload_source_file(SourceFile *file);
+
+#endif
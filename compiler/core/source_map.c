@@ -0,0 +1,93 @@
+#include "source_map.h"
+
+// SOURCE MAP //
+
+void init_source_map(SourceMap *map)
+{
+    map->capacity = 64;
+    map->line_start = (uint32_t *)malloc(sizeof(uint32_t) * map->capacity);
+    map->line_start[0] = 0;
+    map->line_count = 1;
+    map->source_length = 0;
+}
+
+void free_source_map(SourceMap *map)
+{
+    free(map->line_start);
+    map->line_start = NULL;
+    map->line_count = 0;
+    map->capacity = 0;
+}
+
+void push_line_start(SourceMap *map, size_t pos)
+{
+    if (map->line_count == map->capacity)
+    {
+        map->capacity *= 2;
+        map->line_start = (uint32_t *)realloc(map->line_start, sizeof(uint32_t) * map->capacity);
+    }
+    map->line_start[map->line_count++] = (uint32_t)pos;
+}
+
+// Add the lines that start after a newline in the source text between `begin` and `end`
+void add_source_lines(SourceMap *map, const char *source_text, size_t begin, size_t end)
+{
+    const char *character = source_text + begin;
+    const char *stop = source_text + end;
+    while (character < stop)
+    {
+        const char *newline = (const char *)memchr(character, '\n', stop - character);
+        if (!newline)
+            break;
+
+        push_line_start(map, newline + 1 - source_text);
+        character = newline + 1;
+    }
+
+    if (end > map->source_length)
+        map->source_length = end;
+}
+
+// Append the lines of a map that covers a later section of the same source text
+void append_source_map(SourceMap *map, SourceMap *other)
+{
+    for (size_t i = 1; i < other->line_count; i++)
+        push_line_start(map, other->line_start[i]);
+
+    if (other->source_length > map->source_length)
+        map->source_length = other->source_length;
+}
+
+// Returns the 0-based index of the line that contains `pos`
+size_t find_source_line(SourceMap *map, size_t pos)
+{
+    size_t low = 0;
+    size_t high = map->line_count;
+    while (high - low > 1)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (map->line_start[mid] <= pos)
+            low = mid;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Returns the offset of the newline at the end of the line, or the length of the source for the last line
+size_t get_source_line_end(SourceMap *map, size_t line)
+{
+    if (line + 1 < map->line_count)
+        return map->line_start[line + 1] - 1;
+    return map->source_length;
+}
+
+SourcePosition get_source_position(SourceMap *map, size_t pos)
+{
+    size_t line = find_source_line(map, pos);
+
+    SourcePosition position;
+    position.line = line + 1;
+    position.column = pos - map->line_start[line] + 1;
+    return position;
+}
@@ -0,0 +1,32 @@
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+#include "libs.h"
+
+// SOURCE MAP //
+// Maps offsets in the source text to lines and columns, using the offset of the start of each line.
+
+typedef struct
+{
+    uint32_t *line_start; // Sorted, with line_start[0] always 0
+    size_t line_count;
+    size_t capacity;
+    size_t source_length;
+} SourceMap;
+
+typedef struct
+{
+    size_t line;   // 1-based
+    size_t column; // 1-based
+} SourcePosition;
+
+void init_source_map(SourceMap *map);
+void free_source_map(SourceMap *map);
+void add_source_lines(SourceMap *map, const char *source_text, size_t begin, size_t end);
+void append_source_map(SourceMap *map, SourceMap *other);
+
+size_t find_source_line(SourceMap *map, size_t pos);
+size_t get_source_line_end(SourceMap *map, size_t line);
+SourcePosition get_source_position(SourceMap *map, size_t pos);
+
+#endif
@@ -3,10 +3,11 @@
 
 #include "libs.h"
 
+// NOTE: Positions are 32-bit to keep APM nodes small, matching the token arrays
 typedef struct
 {
-    size_t pos;
-    size_t len;
+    uint32_t pos;
+    uint32_t len;
 } substr;
 
 void printf_substr(const char *str, substr sub);
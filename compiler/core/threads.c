@@ -0,0 +1,164 @@
+#include "threads.h"
+#include "fatal_error.h"
+#include "memory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// THREADS //
+
+size_t get_processor_count()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = (long)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? (size_t)count : 1;
+}
+
+typedef struct
+{
+    void *(*function)(void *);
+    void *arg;
+} ThreadStart;
+
+// Threads give their pool of buckets back when they finish, so that later threads can reuse them
+void *run_thread(void *arg)
+{
+    ThreadStart start = *(ThreadStart *)arg;
+    free(arg);
+
+    void *result = start.function(start.arg);
+    return_thread_buckets();
+    return result;
+}
+
+void start_thread(Thread *thread, void *(*function)(void *), void *arg)
+{
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    start->function = function;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, run_thread, (void *)start) != 0)
+        fatal_error("Unable to start thread.");
+}
+
+void join_thread(Thread *thread)
+{
+    pthread_join(*thread, NULL);
+}
+
+void run_once(Once *once, void (*function)())
+{
+    pthread_once(once, function);
+}
+
+// MUTEXES AND CONDITIONS //
+
+void init_mutex(Mutex *mutex)
+{
+    pthread_mutex_init(mutex, NULL);
+}
+
+void free_mutex(Mutex *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+
+void lock_mutex(Mutex *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+void unlock_mutex(Mutex *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+void init_condition(Condition *condition)
+{
+    pthread_cond_init(condition, NULL);
+}
+
+void free_condition(Condition *condition)
+{
+    pthread_cond_destroy(condition);
+}
+
+void wait_for_condition(Condition *condition, Mutex *mutex)
+{
+    pthread_cond_wait(condition, mutex);
+}
+
+void signal_condition(Condition *condition)
+{
+    pthread_cond_signal(condition);
+}
+
+// WORK POOLS //
+
+typedef struct
+{
+    WorkFunction function;
+    void *context;
+    size_t job_count;
+    size_t next_job;
+} WorkPool;
+
+typedef struct
+{
+    WorkPool *pool;
+    size_t worker;
+} Worker;
+
+void *run_worker(void *arg)
+{
+    Worker *worker = (Worker *)arg;
+    WorkPool *pool = worker->pool;
+
+    while (true)
+    {
+        size_t job = atomic_fetch_add(&pool->next_job, 1);
+        if (job >= pool->job_count)
+            break;
+
+        pool->function(pool->context, worker->worker, job);
+    }
+
+    return NULL;
+}
+
+void run_in_parallel(size_t job_count, size_t worker_count, WorkFunction function, void *context)
+{
+    assert(worker_count > 0);
+
+    WorkPool pool = {
+        .function = function,
+        .context = context,
+        .job_count = job_count,
+        .next_job = 0,
+    };
+
+    Worker *workers = (Worker *)malloc(sizeof(Worker) * worker_count);
+    Thread *threads = (Thread *)malloc(sizeof(Thread) * worker_count);
+
+    for (size_t i = 0; i < worker_count; i++)
+        workers[i] = (Worker){.pool = &pool, .worker = i};
+
+    for (size_t i = 1; i < worker_count; i++)
+        start_thread(&threads[i], run_worker, (void *)&workers[i]);
+
+    run_worker((void *)&workers[0]);
+
+    for (size_t i = 1; i < worker_count; i++)
+        join_thread(&threads[i]);
+
+    free(workers);
+    free(threads);
+}
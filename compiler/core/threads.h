@@ -0,0 +1,55 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "libs.h"
+
+#include <pthread.h>
+
+// THREADS //
+
+typedef pthread_t Thread;
+
+size_t get_processor_count();
+void start_thread(Thread *thread, void *(*function)(void *), void *arg);
+void join_thread(Thread *thread);
+
+// Runs a function exactly once, however many threads reach it
+typedef pthread_once_t Once;
+#define ONCE_INIT PTHREAD_ONCE_INIT
+
+void run_once(Once *once, void (*function)());
+
+// MUTEXES AND CONDITIONS //
+
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Condition;
+
+// Initialises a mutex with static storage, which is never freed
+#define MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+
+void init_mutex(Mutex *mutex);
+void free_mutex(Mutex *mutex);
+void lock_mutex(Mutex *mutex);
+void unlock_mutex(Mutex *mutex);
+
+void init_condition(Condition *condition);
+void free_condition(Condition *condition);
+void wait_for_condition(Condition *condition, Mutex *mutex);
+void signal_condition(Condition *condition);
+
+// ATOMICS //
+
+#define atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define atomic_store(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define atomic_fetch_add(ptr, value) __atomic_fetch_add(ptr, value, __ATOMIC_ACQ_REL)
+
+// WORK POOLS //
+// Runs a job for every index below `job_count`, spread over `worker_count` workers.
+// Each worker claims the next unclaimed job as it becomes free, so uneven jobs are balanced.
+// The calling thread acts as worker 0.
+
+typedef void (*WorkFunction)(void *context, size_t worker, size_t job);
+
+void run_in_parallel(size_t job_count, size_t worker_count, WorkFunction function, void *context);
+
+#endif
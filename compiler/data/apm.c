@@ -10,28 +10,64 @@ DEFINE_ENUM(LIST_SYMBOL_TAG, SymbolTag, symbol_tag)
 
 // Create strongly-typed lists from allocators
 
-#define DEFINE_LIST_OF(T, snake_case)                        \
-    T##List create_##snake_case##_list(Allocator *allocator) \
-    {                                                        \
-        return (T##List){                                    \
-            .bucket = allocator->first,                      \
-            .count = count_chunks_of(allocator->first, T),   \
-        };                                                   \
-    }                                                        \
-                                                             \
-    Iterator create_iterator(T##List *list)                  \
-    {                                                        \
-        return create_iterator(list->bucket);                \
-    }                                                        \
-                                                             \
-    T *get_##snake_case(T##List *list, size_t i)             \
-    {                                                        \
-        return get_chunk_of(list->bucket, i, T);             \
+// Most list items hold no pointers into their own list
+void relink_list_items(void *items, size_t count)
+{
+}
+
+// The segments of an if statement are allocated back to back, so
+// the next segment is always the following item in the list
+void relink_list_items(Statement *items, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        Statement *stmt = &items[i];
+
+        if ((stmt->kind == IF_SEGMENT || stmt->kind == ELSE_IF_SEGMENT) && stmt->next)
+        {
+            assert(i + 1 < count);
+            stmt->next = &items[i + 1];
+        }
+    }
+}
+
+#define DEFINE_LIST_OF(T, snake_case)                                                        \
+    T##List create_##snake_case##_list(Allocator *allocator, Allocator *elements)            \
+    {                                                                                        \
+        T##List list = {                                                                     \
+            .items = NULL,                                                                   \
+            .count = count_chunks_of(elements->first, T),                                    \
+        };                                                                                   \
+                                                                                             \
+        if (list.count > 0)                                                                  \
+        {                                                                                    \
+            list.items = (T *)allocate_chunk(allocator, list.count * sizeof(T), alignof(T)); \
+                                                                                             \
+            T *element;                                                                      \
+            size_t i = 0;                                                                    \
+            Iterator it = create_iterator(elements->first);                                  \
+            while (element = advance_iterator_of(&it, T))                                    \
+                list.items[i++] = *element;                                                  \
+                                                                                             \
+            relink_list_items(list.items, list.count);                                       \
+        }                                                                                    \
+                                                                                             \
+        release_allocator(elements);                                                         \
+        return list;                                                                         \
+    }                                                                                        \
+                                                                                             \
+    Iterator create_iterator(T##List *list)                                                  \
+    {                                                                                        \
+        return create_array_iterator(list->items, list->count * sizeof(T));                  \
+    }                                                                                        \
+                                                                                             \
+    T *get_##snake_case(T##List *list, size_t i)                                             \
+    {                                                                                        \
+        assert(i < list->count);                                                             \
+        return &list->items[i];                                                              \
     }
 
-DEFINE_LIST_OF(Argument, argument)
 DEFINE_LIST_OF(EnumValue, enum_value)
-DEFINE_LIST_OF(Expression, expression)
 DEFINE_LIST_OF(Parameter, parameter)
 DEFINE_LIST_OF(Property, property)
 DEFINE_LIST_OF(Statement, statement)
@@ -41,7 +77,8 @@ DEFINE_LIST_OF(Statement, statement)
 // FIXME: Indicate if the type is noneable
 const char *rhino_type_string(Program *apm, RhinoType ty)
 {
-    switch (ty.tag)
+    TypeInfo *data = get_type_info(apm, ty);
+    switch (data->tag)
     {
 
     case RHINO_INVALID_TYPE_TAG:
@@ -54,7 +91,7 @@ const char *rhino_type_string(Program *apm, RhinoType ty)
         return "ERROR_TYPE";
 
     case RHINO_NATIVE_TYPE:
-        return ty.native_type->name;
+        return data->native_type->name;
 
     case RHINO_ENUM_TYPE:
         // FIXME: Return the name of the struct, rather than the tag name
@@ -65,13 +102,210 @@ const char *rhino_type_string(Program *apm, RhinoType ty)
         return "STRUCT_TYPE";
 
     default:
-        fatal_error("Could not stringify %s Rhino type.", rhino_type_tag_string(ty.tag));
+        fatal_error("Could not stringify %s Rhino type.", rhino_type_tag_string(data->tag));
         break;
     }
 
     unreachable;
 }
 
+// TYPE TABLE //
+
+void init_program(Program *apm, Allocator *allocator, Allocator *expression_allocator)
+{
+    apm->none_type.name = "none";
+    apm->bool_type.name = "bool";
+    apm->int_type.name = "int";
+    apm->num_type.name = "num";
+    apm->str_type.name = "str";
+
+    TypeTable *types = &apm->types;
+    types->allocator = allocator;
+    init_mutex(&types->lock);
+    types->data = NULL;
+    types->count = 0;
+    types->capacity = 0;
+    types->slot = NULL;
+
+    intern_type(apm, RHINO_INVALID_TYPE_TAG, false, NULL);
+    intern_type(apm, RHINO_UNINITIALISED_TYPE_TAG, false, NULL);
+    intern_type(apm, RHINO_ERROR_TYPE, false, NULL);
+    intern_type(apm, RHINO_NATIVE_TYPE, false, &apm->bool_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, false, &apm->int_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, false, &apm->num_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, false, &apm->str_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, true, &apm->none_type);
+    assert(types->count == NATIVE_NONE + 1);
+
+    // Interned up front, so resolving never adds types to the table
+    intern_type(apm, RHINO_NATIVE_TYPE, true, &apm->bool_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, true, &apm->int_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, true, &apm->num_type);
+    intern_type(apm, RHINO_NATIVE_TYPE, true, &apm->str_type);
+
+    ExpressionTable *expressions = &apm->expressions;
+    expressions->allocator = expression_allocator;
+    init_mutex(&expressions->lock);
+    expressions->chunks = NULL;
+    expressions->chunk_count = 0;
+    expressions->chunk_capacity = 0;
+}
+
+size_t type_slot(TypeTable *types, RhinoTypeTag tag, bool is_noneable, void *ptr)
+{
+    size_t hash = ((size_t)ptr >> 3) * 2654435769u + (size_t)tag * 2 + is_noneable;
+    size_t i = (hash ^ (hash >> 16)) & (types->capacity - 1);
+
+    while (types->slot[i] != INVALID_TYPE)
+    {
+        TypeInfo *data = &types->data[types->slot[i]];
+        if (data->tag == tag && data->is_noneable == is_noneable && data->ptr == ptr)
+            break;
+
+        i = (i + 1) & (types->capacity - 1);
+    }
+    return i;
+}
+
+// NOTE: The old arrays are left in the allocator, so types can still be read from them by other threads
+void grow_type_table(TypeTable *types)
+{
+    size_t capacity = types->capacity == 0 ? INITIAL_TYPE_TABLE_CAPACITY : types->capacity * 2;
+
+    TypeInfo *data = (TypeInfo *)allocate_chunk(types->allocator, sizeof(TypeInfo) * capacity, alignof(TypeInfo));
+    if (types->count > 0)
+        memcpy(data, types->data, sizeof(TypeInfo) * types->count);
+
+    types->slot = (RhinoType *)allocate_chunk(types->allocator, sizeof(RhinoType) * capacity, alignof(RhinoType));
+    for (size_t i = 0; i < capacity; i++)
+        types->slot[i] = INVALID_TYPE;
+
+    types->capacity = capacity;
+    atomic_store(&types->data, data);
+
+    for (RhinoType ty = INVALID_TYPE + 1; ty < types->count; ty++)
+    {
+        TypeInfo *existing = &data[ty];
+        types->slot[type_slot(types, existing->tag, existing->is_noneable, existing->ptr)] = ty;
+    }
+}
+
+RhinoType intern_type_while_locked(TypeTable *types, RhinoTypeTag tag, bool is_noneable, void *ptr)
+{
+    // Noneable types refer to the same type without is_noneable, which is interned first
+    RhinoType base = INVALID_TYPE;
+    if (is_noneable)
+        base = intern_type_while_locked(types, tag, false, ptr);
+
+    // Keep the load factor at or below three quarters
+    if ((types->count + 1) * 4 > types->capacity * 3)
+        grow_type_table(types);
+
+    size_t i = type_slot(types, tag, is_noneable, ptr);
+    if (types->slot[i] != INVALID_TYPE)
+        return types->slot[i];
+
+    // NOTE: The invalid type is interned first, and so is never put in a slot
+    RhinoType ty = (RhinoType)types->count++;
+    types->data[ty] = (TypeInfo){.tag = tag, .is_noneable = is_noneable, .base = is_noneable ? base : ty, .ptr = ptr};
+    types->slot[i] = ty;
+    return ty;
+}
+
+// Find the type with this tag and pointer, adding it to the type table if it does not exist yet
+RhinoType intern_type(Program *apm, RhinoTypeTag tag, bool is_noneable, void *ptr)
+{
+    lock_mutex(&apm->types.lock);
+    RhinoType ty = intern_type_while_locked(&apm->types, tag, is_noneable, ptr);
+    unlock_mutex(&apm->types.lock);
+    return ty;
+}
+
+RhinoType get_noneable_type(Program *apm, RhinoType ty)
+{
+    TypeInfo *data = get_type_info(apm, ty);
+    if (data->is_noneable)
+        return ty;
+    return intern_type(apm, data->tag, true, data->ptr);
+}
+
+TypeInfo *get_type_info(Program *apm, RhinoType ty)
+{
+    return &atomic_load(&apm->types.data)[ty];
+}
+
+// EXPRESSION TABLE //
+
+// Returns the index of the first expression in a chunk that only the caller will add to
+ExpressionIndex claim_expression_chunk(Program *apm)
+{
+    ExpressionTable *table = &apm->expressions;
+    lock_mutex(&table->lock);
+
+    // NOTE: The old array is left in the allocator, so chunks can still be found through it by other threads
+    if (table->chunk_count == table->chunk_capacity)
+    {
+        size_t capacity = table->chunk_capacity == 0 ? INITIAL_EXPRESSION_CHUNK_CAPACITY : table->chunk_capacity * 2;
+        ExpressionChunk *chunks = (ExpressionChunk *)allocate_chunk(table->allocator, sizeof(ExpressionChunk) * capacity, alignof(ExpressionChunk));
+        if (table->chunk_capacity > 0)
+            memcpy(chunks, table->chunks, sizeof(ExpressionChunk) * table->chunk_capacity);
+        for (size_t i = table->chunk_capacity; i < capacity; i++)
+            chunks[i] = (ExpressionChunk){.expression = NULL, .span = NULL};
+
+        table->chunk_capacity = capacity;
+        atomic_store(&table->chunks, chunks);
+    }
+
+    // Chunks that were discarded are reused
+    ExpressionChunk *chunk = &table->chunks[table->chunk_count];
+    if (!chunk->expression)
+    {
+        chunk->expression = (Expression *)allocate_chunk(table->allocator, sizeof(Expression) * EXPRESSION_CHUNK_SIZE, alignof(Expression));
+        chunk->span = (substr *)allocate_chunk(table->allocator, sizeof(substr) * EXPRESSION_CHUNK_SIZE, alignof(substr));
+    }
+
+    ExpressionIndex first = (ExpressionIndex)(table->chunk_count << EXPRESSION_CHUNK_BITS);
+    table->chunk_count++;
+    unlock_mutex(&table->lock);
+
+    if (first == NO_EXPRESSION)
+    {
+        chunk->expression[0].kind = INVALID_EXPRESSION;
+        chunk->span[0] = (substr){.pos = 0, .len = 0};
+        first++;
+    }
+    return first;
+}
+
+// Forget every chunk claimed after the first `chunk_count`, so their expressions can be replaced
+// NOTE: No other thread can be adding to the table
+void discard_expression_chunks(Program *apm, size_t chunk_count)
+{
+    assert(chunk_count <= apm->expressions.chunk_count);
+    apm->expressions.chunk_count = chunk_count;
+}
+
+Expression *get_expression(Program *apm, ExpressionIndex index)
+{
+    assert(index != NO_EXPRESSION);
+    return &atomic_load(&apm->expressions.chunks)[index >> EXPRESSION_CHUNK_BITS].expression[index & (EXPRESSION_CHUNK_SIZE - 1)];
+}
+
+substr *get_expression_span(Program *apm, ExpressionIndex index)
+{
+    assert(index != NO_EXPRESSION);
+    return &atomic_load(&apm->expressions.chunks)[index >> EXPRESSION_CHUNK_BITS].span[index & (EXPRESSION_CHUNK_SIZE - 1)];
+}
+
+// The arguments of a call are stored as ARGUMENT expressions directly after it
+ExpressionIndex get_argument(Program *apm, ExpressionIndex call, size_t i)
+{
+    assert(i < get_expression(apm, call)->argument_count);
+    Expression *argument = get_expression(apm, call + 1 + (ExpressionIndex)i);
+    assert(argument->kind == ARGUMENT);
+    return argument->argument;
+}
+
 // SYMBOL TABLES //
 
 SymbolTable *allocate_symbol_table(Allocator *allocator, SymbolTable *parent)
@@ -79,31 +313,70 @@ SymbolTable *allocate_symbol_table(Allocator *allocator, SymbolTable *parent)
     SymbolTable *table = (SymbolTable *)allocate(allocator, SymbolTable);
     table->next = parent;
     table->symbol_count = 0;
+    table->capacity = 0;
+    table->symbol = NULL;
     return table;
 }
 
-void declare_symbol(Allocator *allocator, SymbolTable *table, SymbolTag tag, void *ptr, substr identity)
+size_t symbol_slot(SymbolTable *table, Atom identity_atom)
 {
-    while (table->symbol_count == SYMBOL_TABLE_SIZE && table->next)
-        table = table->next;
+    size_t i = (size_t)((identity_atom * 2654435769u) >> 8) & (table->capacity - 1);
+    while (table->symbol[i].tag != INVALID_SYMBOL && table->symbol[i].identity_atom != identity_atom)
+        i = (i + 1) & (table->capacity - 1);
+    return i;
+}
+
+void grow_symbol_table(Allocator *allocator, SymbolTable *table)
+{
+    Symbol *old_symbol = table->symbol;
+    size_t old_capacity = table->capacity;
+
+    // NOTE: The old array is left in the allocator, as the allocator cannot free individual chunks
+    table->capacity = old_capacity == 0 ? INITIAL_SYMBOL_TABLE_CAPACITY : old_capacity * 2;
+    table->symbol = (Symbol *)allocate_chunk(allocator, sizeof(Symbol) * table->capacity, alignof(Symbol));
+    for (size_t i = 0; i < table->capacity; i++)
+        table->symbol[i].tag = INVALID_SYMBOL;
 
-    if (table->symbol_count == SYMBOL_TABLE_SIZE)
+    for (size_t i = 0; i < old_capacity; i++)
     {
-        SymbolTable *next = allocate_symbol_table(allocator, table->next);
-        table->next = next;
-
-        next->next = 0;
-        next->symbol_count = 1;
-        next->symbol[0].ptr = ptr;
-        next->symbol[0].tag = tag;
-        next->symbol[0].identity = identity;
+        if (old_symbol[i].tag != INVALID_SYMBOL)
+            table->symbol[symbol_slot(table, old_symbol[i].identity_atom)] = old_symbol[i];
+    }
+}
+
+// NOTE: If a symbol with the same identity has already been declared in this scope, that symbol is kept
+void declare_symbol(Allocator *allocator, SymbolTable *table, SymbolTag tag, void *ptr, Atom identity_atom)
+{
+    // Keep the load factor at or below three quarters
+    if ((table->symbol_count + 1) * 4 > table->capacity * 3)
+        grow_symbol_table(allocator, table);
+
+    Symbol *symbol = &table->symbol[symbol_slot(table, identity_atom)];
+    if (symbol->tag != INVALID_SYMBOL)
         return;
+
+    symbol->tag = tag;
+    symbol->ptr = ptr;
+    symbol->identity_atom = identity_atom;
+    table->symbol_count++;
+}
+
+// Returns NULL if there is no symbol with this identity in this scope or any parent scope
+Symbol *find_symbol(SymbolTable *table, Atom identity_atom)
+{
+    while (table)
+    {
+        if (table->symbol_count > 0)
+        {
+            Symbol *symbol = &table->symbol[symbol_slot(table, identity_atom)];
+            if (symbol->tag != INVALID_SYMBOL)
+                return symbol;
+        }
+
+        table = table->next;
     }
 
-    size_t i = table->symbol_count++;
-    table->symbol[i].ptr = ptr;
-    table->symbol[i].tag = tag;
-    table->symbol[i].identity = identity;
+    return NULL;
 }
 
 // PRINT APM //
@@ -126,7 +399,8 @@ bool is_declaration(Statement *stmt)
 
 // TYPE ANALYSIS METHODS //
 
-RhinoType get_expression_type(Program *apm, const char *source_text, Expression *expr)
+// Determine the type of an expression from the types already stored in its subexpressions
+RhinoType determine_expression_type(Program *apm, Expression *expr)
 {
     switch (expr->kind)
     {
@@ -162,30 +436,30 @@ RhinoType get_expression_type(Program *apm, const char *source_text, Expression
     case PARAMETER_REFERENCE:
         return expr->parameter->type;
 
+    // Functions, types and ranges are not values
+    case FUNCTION_REFERENCE:
+    case TYPE_REFERENCE:
+    case RANGE_LITERAL:
+        return INVALID_TYPE;
+
+    case PROPERTY_REFERENCE:
+        return expr->property->type;
+
     // Function call
     case FUNCTION_CALL:
-        if (expr->callee->kind == FUNCTION_REFERENCE)
-            return expr->callee->function->return_type;
+    {
+        Expression *callee = get_expression(apm, expr->callee);
+        if (callee->kind == FUNCTION_REFERENCE)
+            return callee->function->return_type;
 
         return ERROR_TYPE;
+    }
 
     // Index by field
     case INDEX_BY_FIELD:
     {
-        RhinoType subject_type = get_expression_type(apm, source_text, expr->subject);
-
-        if (subject_type.tag == RHINO_STRUCT_TYPE)
-        {
-            Property *property;
-            Iterator it = create_iterator(subject_type.struct_type->properties.bucket);
-            while (property = advance_iterator_of(&it, Property))
-            {
-                if (substr_match(source_text, property->identity, expr->field))
-                    return property->type;
-            }
-        }
-
-        return ERROR_TYPE;
+        Expression *field = get_expression(apm, expr->field);
+        return field->kind == PROPERTY_REFERENCE ? field->property->type : ERROR_TYPE;
     }
 
     // Numerical operations
@@ -193,7 +467,7 @@ RhinoType get_expression_type(Program *apm, const char *source_text, Expression
     case UNARY_NEG:
     case UNARY_INCREMENT:
     case UNARY_DECREMENT:
-        return get_expression_type(apm, source_text, expr->operand);
+        return get_expression(apm, expr->operand)->resolved_type;
 
     case UNARY_NOT:
         return NATIVE_BOOL;
@@ -206,9 +480,7 @@ RhinoType get_expression_type(Program *apm, const char *source_text, Expression
     case BINARY_ADD:
     case BINARY_SUBTRACT:
     {
-        RhinoType lhs_type = get_expression_type(apm, source_text, expr->lhs);
-        RhinoType rhs_type = get_expression_type(apm, source_text, expr->rhs);
-        if (IS_INT_TYPE(lhs_type) && IS_INT_TYPE(rhs_type))
+        if (IS_INT_TYPE(get_expression(apm, expr->lhs)->resolved_type) && IS_INT_TYPE(get_expression(apm, expr->rhs)->resolved_type))
             return NATIVE_INT;
 
         return NATIVE_NUM;
@@ -225,6 +497,9 @@ RhinoType get_expression_type(Program *apm, const char *source_text, Expression
     case BINARY_LOGICAL_OR:
         return NATIVE_BOOL;
 
+    case TYPE_CAST:
+        return expr->cast_type;
+
     default:
         fatal_error("Could not determine type of %s expression.", expression_kind_string(expr->kind));
         break;
@@ -233,52 +508,26 @@ RhinoType get_expression_type(Program *apm, const char *source_text, Expression
     unreachable;
 }
 
-// NOTE: The behaviour of this function has not been consider for RhinoTypes
-//       RHINO_INVALID_TYPE_TAG / RHINO_UNINITIALISED_TYPE_TAG / RHINO_ERROR_TYPE
-bool are_types_equal(RhinoType a, RhinoType b)
-{
-    if (a.tag != b.tag)
-        return false;
-
-    if (a.is_noneable != b.is_noneable)
-        return false;
-
-    if (a.tag == RHINO_NATIVE_TYPE && a.native_type != b.native_type)
-        return false;
-
-    if (a.tag == RHINO_ENUM_TYPE && a.enum_type != b.enum_type)
-        return false;
-
-    if (a.tag == RHINO_STRUCT_TYPE && a.enum_type != b.enum_type)
-        return false;
-
-    return true;
-}
-
-bool is_native_type(RhinoType ty, NativeType *native_type)
-{
-    return ty.tag == RHINO_NATIVE_TYPE && !ty.is_noneable && ty.native_type == native_type;
-}
-
 bool allow_assign_a_to_b(Program *apm, RhinoType a, RhinoType b)
 {
     if (!IS_VALID_TYPE(a) || !IS_VALID_TYPE(b))
         return true;
 
-    if (are_types_equal(a, b))
+    if (a == b)
         return true;
 
     if (IS_INT_TYPE(a) && IS_NUM_TYPE(b))
         return true;
 
-    if (a.is_noneable && b.is_noneable)
+    TypeInfo *a_data = get_type_info(apm, a);
+    TypeInfo *b_data = get_type_info(apm, b);
+
+    if (a_data->is_noneable && b_data->is_noneable)
         return true;
 
-    if (!a.is_noneable && b.is_noneable)
+    if (!a_data->is_noneable && b_data->is_noneable)
     {
-        RhinoType b_ = b;
-        b_.is_noneable = false;
-        if (allow_assign_a_to_b(apm, a, b_))
+        if (allow_assign_a_to_b(apm, a, b_data->base))
             return true;
     }
 
@@ -5,7 +5,8 @@
 
 // Forward Declarations
 
-typedef struct RhinoType RhinoType;
+typedef uint32_t RhinoType;
+typedef uint32_t ExpressionIndex;
 typedef struct NativeType NativeType;
 
 typedef struct EnumValue EnumValue;
@@ -25,26 +26,24 @@ typedef struct SymbolTable SymbolTable;
 
 typedef struct Function Function;
 typedef struct Parameter Parameter;
-typedef struct Argument Argument;
 
 typedef struct Program Program;
 
 // Create strongly-typed lists from allocators
-
-#define DECLARE_LIST_OF(T, snake_case)                        \
-    typedef struct                                            \
-    {                                                         \
-        Bucket *bucket;                                       \
-        size_t count;                                         \
-    } T##List;                                                \
-                                                              \
-    T##List create_##snake_case##_list(Allocator *allocator); \
-    Iterator create_iterator(T##List *list);                  \
+// NOTE: Elements are copied into one contiguous array once the list is complete
+
+#define DECLARE_LIST_OF(T, snake_case)                                             \
+    typedef struct                                                                 \
+    {                                                                              \
+        T *items;                                                                  \
+        size_t count;                                                              \
+    } T##List;                                                                     \
+                                                                                   \
+    T##List create_##snake_case##_list(Allocator *allocator, Allocator *elements); \
+    Iterator create_iterator(T##List *list);                                       \
     T *get_##snake_case(T##List *list, size_t i);
 
-DECLARE_LIST_OF(Argument, argument)
 DECLARE_LIST_OF(EnumValue, enum_value)
-DECLARE_LIST_OF(Expression, expression)
 DECLARE_LIST_OF(Parameter, parameter)
 DECLARE_LIST_OF(Property, property)
 DECLARE_LIST_OF(Statement, statement)
@@ -64,10 +63,13 @@ DECLARE_LIST_OF(Statement, statement)
 
 DECLARE_ENUM(LIST_RHINO_TYPE_TAG, RhinoTypeTag, rhino_type_tag)
 
-struct RhinoType
+// Every distinct type is interned once in the program's type table, and a RhinoType is its
+// index in that table. Two types are equal exactly when their RhinoTypes are equal.
+typedef struct
 {
     RhinoTypeTag tag;
     bool is_noneable;
+    RhinoType base; // The same type without is_noneable
     union
     {
         void *ptr;
@@ -75,27 +77,35 @@ struct RhinoType
         EnumType *enum_type;     // RHINO_ENUM_TYPE
         StructType *struct_type; // RHINO_STRUCT_TYPE
     };
-};
-
-// RHINO_INVALID_TYPE_TAG / RHINO_UNINITIALISED_TYPE_TAG / RHINO_ERROR_TYPE
-#define ERROR_TYPE ((RhinoType){RHINO_ERROR_TYPE, 0})
-
-#define IS_VALID_TYPE(ty) !(ty.tag == RHINO_INVALID_TYPE_TAG ||       \
-                            ty.tag == RHINO_UNINITIALISED_TYPE_TAG || \
-                            ty.tag == RHINO_ERROR_TYPE)
+} TypeInfo;
 
-// RHINO_NATIVE_TYPE
-#define NATIVE_NONE ((RhinoType){RHINO_NATIVE_TYPE, true, &apm->none_type})
-#define NATIVE_BOOL ((RhinoType){RHINO_NATIVE_TYPE, false, &apm->bool_type})
-#define NATIVE_INT ((RhinoType){RHINO_NATIVE_TYPE, false, &apm->int_type})
-#define NATIVE_NUM ((RhinoType){RHINO_NATIVE_TYPE, false, &apm->num_type})
-#define NATIVE_STR ((RhinoType){RHINO_NATIVE_TYPE, false, &apm->str_type})
+#define INITIAL_TYPE_TABLE_CAPACITY 64
 
-// RHINO_ENUM_TYPE
-#define ENUM_TYPE(enum_type) ((RhinoType){RHINO_ENUM_TYPE, false, enum_type})
-
-// RHINO_STRUCT_TYPE
-#define STRUCT_TYPE(struct_type) ((RhinoType){RHINO_STRUCT_TYPE, false, struct_type})
+typedef struct
+{
+    Allocator *allocator; // NOTE: Only allocated from while holding the lock
+    Mutex lock;           // Held while interning, interned types can be read without it
+    TypeInfo *data;       // Indexed by RhinoType, replaced by a larger copy when full
+    size_t count;
+    size_t capacity; // Always a power of two
+    RhinoType *slot; // Hash table of interned types, empty slots are INVALID_TYPE
+} TypeTable;
+
+// These types are interned first by init_program, so always have the same index
+#define INVALID_TYPE ((RhinoType)0)
+#define UNINITIALISED_TYPE ((RhinoType)1)
+#define ERROR_TYPE ((RhinoType)2)
+#define NATIVE_BOOL ((RhinoType)3)
+#define NATIVE_INT ((RhinoType)4)
+#define NATIVE_NUM ((RhinoType)5)
+#define NATIVE_STR ((RhinoType)6)
+#define NATIVE_NONE ((RhinoType)8) // The base of none is never used, and is type 7
+
+#define IS_VALID_TYPE(ty) ((ty) > ERROR_TYPE)
+
+// RHINO_ENUM_TYPE / RHINO_STRUCT_TYPE
+#define ENUM_TYPE(enum_type) ((enum_type)->type)
+#define STRUCT_TYPE(struct_type) ((struct_type)->type)
 
 // Native Type
 
@@ -109,6 +119,7 @@ struct EnumValue
 {
     substr span;
     substr identity;
+    Atom identity_atom;
     EnumType *type_of_enum_value; // FIXME: I would like to not have this if possible
 };
 
@@ -117,7 +128,10 @@ struct EnumType
 {
     substr span;
     substr identity;
+    Atom identity_atom;
     EnumValueList values;
+    RhinoType type;
+    bool is_reachable;
 };
 
 // Property
@@ -125,7 +139,8 @@ struct Property
 {
     substr span;
     substr identity;
-    Expression *type_expression;
+    Atom identity_atom;
+    ExpressionIndex type_expression;
     RhinoType type;
 };
 
@@ -134,16 +149,20 @@ struct StructType
 {
     substr span;
     substr identity;
+    Atom identity_atom;
     PropertyList properties;
     Block *body;
+    RhinoType type;
+    bool is_reachable;
 };
 
 // Variable
 struct Variable
 {
     substr identity;
+    Atom identity_atom;
     RhinoType type;
-    size_t order; // FIXME: Is there a better name for this?
+    size_t order; // Position of a global variable in its block's initialisers
 };
 
 // Symbol table
@@ -169,20 +188,24 @@ typedef struct
         EnumType *enum_type;
         StructType *struct_type;
     };
-    substr identity;
+    Atom identity_atom;
 } Symbol;
 
-#define SYMBOL_TABLE_SIZE 16
+// Each symbol table is a hash table of the symbols declared in one scope, keyed by atom.
+// Symbols that are not found are then searched for in the parent scope, `next`.
+#define INITIAL_SYMBOL_TABLE_CAPACITY 8
 
 struct SymbolTable
 {
-    size_t symbol_count;
     SymbolTable *next;
-    Symbol symbol[SYMBOL_TABLE_SIZE];
+    size_t symbol_count;
+    size_t capacity; // Always a power of two
+    Symbol *symbol;  // Empty slots have the tag INVALID_SYMBOL
 };
 
 SymbolTable *allocate_symbol_table(Allocator *allocator, SymbolTable *parent);
-void declare_symbol(Allocator *allocator, SymbolTable *table, SymbolTag tag, void *ptr, substr identity);
+void declare_symbol(Allocator *allocator, SymbolTable *table, SymbolTag tag, void *ptr, Atom identity_atom);
+Symbol *find_symbol(SymbolTable *table, Atom identity_atom);
 
 // Expression Precedence
 // Ordered from "happens last" to "happens first"
@@ -218,8 +241,10 @@ DECLARE_ENUM(LIST_EXPR_PRECEDENCE, ExprPrecedence, expr_precedence)
     MACRO(FUNCTION_REFERENCE)        \
     MACRO(PARAMETER_REFERENCE)       \
     MACRO(TYPE_REFERENCE)            \
+    MACRO(PROPERTY_REFERENCE)        \
                                      \
     MACRO(FUNCTION_CALL)             \
+    MACRO(ARGUMENT)                  \
                                      \
     MACRO(INDEX_BY_FIELD)            \
                                      \
@@ -251,15 +276,17 @@ DECLARE_ENUM(LIST_EXPR_PRECEDENCE, ExprPrecedence, expr_precedence)
 
 DECLARE_ENUM(LIST_EXPRESSIONS, ExpressionKind, expression_kind)
 
+// Expressions are kept small, with their spans and any wider data stored apart from them.
+// They refer to each other by their index in the program's expression table.
 struct Expression
 {
     ExpressionKind kind;
-    substr span;
+    RhinoType resolved_type; // Stored by the resolver, see determine_expression_type
     union
     {
-        struct // IDENTITY_LITERAL
+        struct // IDENTITY_LITERAL, whose identity is the span of the expression
         {
-            substr identity;
+            Atom identity_atom;
             bool given_error;
         };
         struct // BOOLEAN_LITERAL
@@ -268,7 +295,7 @@ struct Expression
         };
         struct // INTEGER_LITERAL
         {
-            int integer_value;
+            int64_t integer_value;
         };
         struct // FLOAT_LITERAL
         {
@@ -298,42 +325,74 @@ struct Expression
         {
             RhinoType type;
         };
+        struct // PROPERTY_REFERENCE
+        {
+            Property *property;
+        };
         struct // FUNCTION_CALL
         {
-            Expression *callee;
-            ArgumentList arguments;
+            ExpressionIndex callee;
+            uint32_t argument_count; // The arguments are stored directly after the call, see get_argument
+        };
+        struct // ARGUMENT
+        {
+            ExpressionIndex argument;
         };
         struct // INDEX_BY_FIELD
         {
-            Expression *subject;
-            substr field;
+            ExpressionIndex subject;
+            ExpressionIndex field; // An IDENTITY_LITERAL, replaced by a PROPERTY_REFERENCE once found by the resolver
         };
         struct // RANGE_LITERAL
         {
-            Expression *first;
-            Expression *last;
+            ExpressionIndex first;
+            ExpressionIndex last;
         };
         struct // NONEABLE_EXPRESSION
         {
-            Expression *__noneable__subject; // NOTE: KEEP SYNCED WITH INDEX_BY_FIELD subject
+            ExpressionIndex __noneable__subject; // NOTE: KEEP SYNCED WITH INDEX_BY_FIELD subject
         };
         struct // UNARY_*
         {
-            Expression *operand;
+            ExpressionIndex operand;
         };
         struct // BINARY_*
         {
-            Expression *lhs;
-            Expression *rhs;
+            ExpressionIndex lhs;
+            ExpressionIndex rhs;
         };
         struct // TYPE_CAST
         {
-            Expression *cast_expr;
+            ExpressionIndex cast_expr;
             RhinoType cast_type;
         };
     };
 };
 
+// Expression table
+// Expressions are stored in fixed size chunks, which are never moved, so an expression can be read by any
+// thread while others add to the table. Each compiler claims whole chunks, and fills them without taking the lock.
+#define NO_EXPRESSION ((ExpressionIndex)0) // Index 0 is never given out
+
+#define EXPRESSION_CHUNK_BITS 9
+#define EXPRESSION_CHUNK_SIZE (1 << EXPRESSION_CHUNK_BITS)
+#define INITIAL_EXPRESSION_CHUNK_CAPACITY 16
+
+typedef struct
+{
+    Expression *expression;
+    substr *span; // Only needed to report errors, so kept apart from the expressions
+} ExpressionChunk;
+
+typedef struct
+{
+    Allocator *allocator;    // NOTE: Only allocated from while holding the lock
+    Mutex lock;              // Held while claiming chunks, expressions can be read without it
+    ExpressionChunk *chunks; // Replaced by a larger copy when full
+    size_t chunk_count;
+    size_t chunk_capacity;
+} ExpressionTable;
+
 // Statement
 #define LIST_STATEMENTS(MACRO)     \
     MACRO(INVALID_STATEMENT)       \
@@ -366,14 +425,14 @@ struct Statement
 {
     StatementKind kind;
     substr span;
+    bool has_valid_identity; // VARIABLE_DECLARATION, kept outside the union to fill the padding
     union
     {
         struct // VARIABLE_DECLARATION
         {
             Variable *variable;
-            Expression *type_expression;
-            Expression *initial_value;
-            bool has_valid_identity;
+            ExpressionIndex type_expression;
+            ExpressionIndex initial_value;
         };
         struct // FUNCTION_DECLARATION
         {
@@ -394,8 +453,8 @@ struct Statement
         struct // IF_SEGMENT / ELSE_IF_SEGMENT / ELSE_SEGMENT / WHILE_LOOP
         {
             Block *body;
-            Expression *condition;
             Statement *next;
+            ExpressionIndex condition;
         };
         struct // BREAK_LOOP
         {
@@ -405,16 +464,16 @@ struct Statement
         {
             Block *__for_body; // NOTE: KEEP SYNCED WITH IF_SEGMENT body
             Variable *iterator;
-            Expression *iterable;
+            ExpressionIndex iterable;
         };
         struct // ASSIGNMENT_STATEMENT
         {
-            Expression *assignment_lhs;
-            Expression *assignment_rhs;
+            ExpressionIndex assignment_lhs;
+            ExpressionIndex assignment_rhs;
         };
         struct // OUTPUT_STATEMENT / EXPRESSION_STMT / RETURN_STATEMENT
         {
-            Expression *expression;
+            ExpressionIndex expression;
         };
     };
 };
@@ -427,7 +486,10 @@ struct Block
     bool singleton_block;
     SymbolTable *symbol_table;
     StatementList statements;
-    size_t max_var_order;
+
+    // Variable declarations of a declaration block, ordered so each is initialised after everything it depends on
+    Statement **initialisers;
+    size_t initialiser_count;
 };
 
 // Function
@@ -435,13 +497,20 @@ struct Function
 {
     substr span;
     substr identity;
-    Block *body;
+    Atom identity_atom;
+    Block *body; // NULL if this is a lazy body that has not been parsed yet
+
+    // When parsing lazily, the bodies of global functions are only parsed once they are referenced
+    bool has_lazy_body;
+    size_t body_token;
 
-    Expression *return_type_expression;
+    ExpressionIndex return_type_expression;
     bool has_return_type_expression;
     RhinoType return_type;
 
     ParameterList parameters;
+
+    bool is_reachable;
 };
 
 // Parameter
@@ -449,16 +518,11 @@ struct Parameter
 {
     substr span;
     substr identity;
-    Expression *type_expression;
+    Atom identity_atom;
+    ExpressionIndex type_expression;
     RhinoType type;
 };
 
-// Argument
-struct Argument
-{
-    Expression *expr;
-};
-
 // Program
 struct Program
 {
@@ -468,12 +532,27 @@ struct Program
     NativeType num_type;
     NativeType str_type;
 
+    TypeTable types;
+    ExpressionTable expressions;
+
     Function *main;
     Block *program_block;
     SymbolTable *global_symbol_table;
 };
 
-void init_program(Program *apm, Allocator *allocator);
+void init_program(Program *apm, Allocator *allocator, Allocator *expression_allocator);
+
+// Type table
+RhinoType intern_type(Program *apm, RhinoTypeTag tag, bool is_noneable, void *ptr);
+RhinoType get_noneable_type(Program *apm, RhinoType ty);
+TypeInfo *get_type_info(Program *apm, RhinoType ty);
+
+// Expression table
+ExpressionIndex claim_expression_chunk(Program *apm);
+void discard_expression_chunks(Program *apm, size_t chunk_count);
+Expression *get_expression(Program *apm, ExpressionIndex index);
+substr *get_expression_span(Program *apm, ExpressionIndex index);
+ExpressionIndex get_argument(Program *apm, ExpressionIndex call, size_t i);
 
 // Display APM
 const char *rhino_type_string(Program *apm, RhinoType ty);
@@ -484,16 +563,14 @@ void print_resolved_apm(Program *apm, const char *source_text);
 bool is_declaration(Statement *stmt);
 
 // Type analysis methods
-RhinoType get_expression_type(Program *apm, const char *source_text, Expression *expr);
-bool are_types_equal(RhinoType a, RhinoType b);
-bool is_native_type(RhinoType ty, NativeType *native_type);
+RhinoType determine_expression_type(Program *apm, Expression *expr);
 bool allow_assign_a_to_b(Program *apm, RhinoType a, RhinoType b);
 
-#define IS_NONE_TYPE(ty) is_native_type(ty, &apm->none_type)
-#define IS_BOOL_TYPE(ty) is_native_type(ty, &apm->bool_type)
-#define IS_INT_TYPE(ty) is_native_type(ty, &apm->int_type)
-#define IS_NUM_TYPE(ty) is_native_type(ty, &apm->num_type)
-#define IS_STR_TYPE(ty) is_native_type(ty, &apm->str_type)
+#define IS_NONE_TYPE(ty) ((ty) == NATIVE_NONE)
+#define IS_BOOL_TYPE(ty) ((ty) == NATIVE_BOOL)
+#define IS_INT_TYPE(ty) ((ty) == NATIVE_INT)
+#define IS_NUM_TYPE(ty) ((ty) == NATIVE_NUM)
+#define IS_STR_TYPE(ty) ((ty) == NATIVE_STR)
 
 // Expression precedence methods
 ExprPrecedence precedence_of(ExpressionKind expr_kind);
@@ -8,6 +8,29 @@ void init_byte_code(ByteCode *byte_code)
 {
     byte_code->init = NULL;
     byte_code->main = NULL;
+    byte_code->run_main = 0;
+    byte_code->lazy_assembler = NULL;
+    byte_code->stubs = NULL;
+}
+
+void free_units(Unit *unit)
+{
+    while (unit)
+    {
+        Unit *next = unit->next;
+        free(unit->lazy_function);
+        free(unit);
+        unit = next;
+    }
+}
+
+void free_byte_code(ByteCode *byte_code)
+{
+    free_units(byte_code->init);
+    free_units(byte_code->stubs);
+    free(byte_code->lazy_assembler);
+
+    init_byte_code(byte_code);
 }
 
 void init_unit(Unit *unit)
@@ -21,6 +44,9 @@ void init_unit(Unit *unit)
 
     unit->nested_in = NULL;
     unit->next = NULL;
+
+    unit->lazy_function = NULL;
+    unit->assembled = NULL;
 }
 
 // TODO: Have functions of these be generated by build.py
@@ -52,17 +52,29 @@ struct Unit
 
     Unit *nested_in;
     Unit *next; // TODO: This is currently used so that we can access all the units. Factor this in some better way.
+
+    // When assembling lazily, functions start out as a stub that is assembled on the first call
+    void *lazy_function; // NULL if this unit is not a stub
+    Unit *assembled;     // The unit the stub was assembled into, if it has been called
 };
 
 typedef struct
 {
     Unit *init;
     Unit *main;
+    size_t run_main; // Position of the instruction in the init unit that runs main
+
+    // When assembling lazily, the assembler is kept so that stubs can be assembled when first called
+    void *lazy_assembler;
+    Unit *stubs; // Stubs are never run, so they are kept out of the list of units
 } ByteCode;
 
 void init_byte_code(ByteCode *byte_code);
+void free_byte_code(ByteCode *byte_code);
 void init_unit(Unit *unit);
 
+size_t get_playload_size(OpCode op);
+
 size_t printf_instruction(Unit *unit, size_t i);
 void printf_unit(Unit *unit);
 void printf_byte_code(ByteCode *byte_code);
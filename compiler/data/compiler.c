@@ -14,52 +14,34 @@ void raise_compilation_error(Compiler *c, CompilationErrorCode code, substr str)
     c->errors[c->error_count].code = code;
     c->errors[c->error_count].str.pos = str.pos;
     c->errors[c->error_count].str.len = str.len;
+    c->errors[c->error_count].order = c->error_count;
     c->error_count++;
 }
 
+int compare_error_positions(const void *a, const void *b)
+{
+    const CompilationError *lhs = (const CompilationError *)a;
+    const CompilationError *rhs = (const CompilationError *)b;
+    if (lhs->str.pos != rhs->str.pos)
+        return lhs->str.pos < rhs->str.pos ? -1 : 1;
+    if (lhs->order != rhs->order)
+        return lhs->order < rhs->order ? -1 : 1;
+    return 0;
+}
+
 void determine_error_positions(Compiler *c)
 {
     // Sort errors by position
-    // This is done both for usability and so that the loop below will work correctly
-    for (size_t i = 0; i < c->error_count; i++)
-    {
-        for (size_t j = i + 1; j < c->error_count; j++)
-        {
-            CompilationError a = c->errors[i];
-            CompilationError b = c->errors[j];
-            if (b.str.pos < a.str.pos)
-            {
-                c->errors[i] = b;
-                c->errors[j] = a;
-            }
-        }
-    }
+    // This is done for usability
+    // Errors at the same position stay in the order they were raised, which is job order when run in parallel
+    qsort(c->errors, c->error_count, sizeof(CompilationError), compare_error_positions);
 
     // Determine positions
-    size_t line = 1;
-    size_t column = 1;
-    size_t pos = 0;
-
-    CompilationError *error = c->errors;
-    for (size_t i = 0; i < c->error_count; pos++)
+    for (size_t i = 0; i < c->error_count; i++)
     {
-        while (pos == error->str.pos)
-        {
-            error->line = line;
-            error->column = column;
-            error = c->errors + ++i;
-        }
-
-        const char *character = c->source_text + pos;
-        if (*character == '\n')
-        {
-            line++;
-            column = 1;
-        }
-        else if (*character == '\0')
-            break;
-        else
-            column++;
+        SourcePosition position = get_source_position(&c->source_map, c->errors[i].str.pos);
+        c->errors[i].line = position.line;
+        c->errors[i].column = position.column;
     }
 }
 
@@ -76,16 +58,9 @@ void printf_compilation_error(Compiler *c, size_t index)
         size_t err_start = error.str.pos;
         size_t err_end = error.str.pos + error.str.len - 1;
 
-        size_t line_start = err_start;
-        while (line_start > 0 && c->source_text[line_start] != '\n')
-            line_start--;
-        if (c->source_text[line_start] == '\n')
-            line_start++;
-
-        size_t line_end = err_end;
-        while (c->source_text[line_end] != '\0' && c->source_text[line_end] != '\n')
-            line_end++;
-        line_end--;
+        SourceMap *map = &c->source_map;
+        size_t line_start = map->line_start[find_source_line(map, err_start)];
+        size_t line_end = get_source_line_end(map, find_source_line(map, err_end)) - 1;
 
         printf("%.*s", err_start - line_start, c->source_text + line_start);
         printf("\x1b[31m");
@@ -112,13 +87,225 @@ void printf_compilation_error(Compiler *c, size_t index)
 DEFINE_ENUM(LIST_PARSE_STATUS, ParseStatus, parse_status)
 
 // Compiler
+void init_compiler_arenas(Compiler *c)
+{
+    init_arena(&c->apm_allocator, APM_ARENA_BUCKET_SIZE);
+    init_arena(&c->expression_arena, EXPRESSION_ARENA_BUCKET_SIZE);
+    init_arena(&c->list_arena, LIST_ARENA_BUCKET_SIZE);
+    init_arena(&c->block_arena, BLOCK_ARENA_BUCKET_SIZE);
+    init_arena(&c->symbol_arena, SYMBOL_ARENA_BUCKET_SIZE);
+}
+
+void release_compiler_arenas(Compiler *c)
+{
+    release_allocator(&c->apm_allocator);
+    release_allocator(&c->expression_arena);
+    release_allocator(&c->list_arena);
+    release_allocator(&c->block_arena);
+    release_allocator(&c->symbol_arena);
+}
+
 void init_compiler(Compiler *c)
 {
-    c->token_capacity = 64;
-    c->token_count = 0;
-    c->tokens = (Token *)malloc(sizeof(Token) * c->token_capacity);
+    c->source_file.text = NULL;
+    c->source_file.length = 0;
+    c->source_file.mapping = NULL;
+    c->source_file.mapping_size = 0;
+    init_source_map(&c->source_map);
+    init_atom_table(&c->atoms);
+
+    c->tokens.kind = NULL;
+    c->tokens.pos = NULL;
+    c->tokens.len = NULL;
+    c->tokens.value = NULL;
+    c->tokens.count = 0;
+    c->tokens.capacity = 0;
+    c->token_stream = NULL;
+    c->tokenise_chunk_count = 0;
+
+    init_compiler_arenas(c);
+    c->next_expression = 0;
+    c->expression_chunk_end = 0;
+    c->parse_lazily = false;
+    c->declared_types = NULL;
+    c->parallel_functions = false;
 
     c->error_capacity = 8;
     c->error_count = 0;
     c->errors = (CompilationError *)malloc(sizeof(CompilationError) * c->error_capacity);
 }
+
+// Rewind the compiler so that it can compile another source file
+// NOTE: The arenas keep their buckets, so a host compiling many scripts reuses the same memory
+void reset_compiler(Compiler *c)
+{
+    unload_source_file(&c->source_file);
+    c->source_path = NULL;
+    c->source_text = NULL;
+
+    free_source_map(&c->source_map);
+    free_atom_table(&c->atoms);
+    init_atom_table(&c->atoms);
+    c->tokens.count = 0;
+    c->tokens.first = 0;
+    c->tokens.retain_from = 0;
+    c->next_expression = 0;
+    c->expression_chunk_end = 0;
+
+    reset_allocator(&c->apm_allocator);
+    reset_allocator(&c->expression_arena);
+    reset_allocator(&c->list_arena);
+    reset_allocator(&c->block_arena);
+    reset_allocator(&c->symbol_arena);
+
+    c->error_count = 0;
+}
+
+void free_compiler(Compiler *c)
+{
+    assert(c->token_stream == NULL);
+
+    unload_source_file(&c->source_file);
+    free_source_map(&c->source_map);
+    free_atom_table(&c->atoms);
+    free_token_array(&c->tokens);
+
+    release_compiler_arenas(c);
+
+    free(c->errors);
+    c->errors = NULL;
+    c->error_count = 0;
+    c->error_capacity = 0;
+}
+
+void fprintf_allocator_stats(FILE *file, const char *name, Allocator *allocator)
+{
+    AllocatorStats stats = get_allocator_stats(allocator);
+    fprintf(file, "%-18s %6zu buckets %6zu large %10zu bytes reserved %10zu bytes used\n",
+           name, stats.bucket_count, stats.large_count, stats.reserved, stats.used);
+}
+
+void fprintf_compiler_memory(FILE *file, Compiler *c)
+{
+    fprintf_allocator_stats(file, "apm_allocator", &c->apm_allocator);
+    fprintf_allocator_stats(file, "expression_arena", &c->expression_arena);
+    fprintf_allocator_stats(file, "list_arena", &c->list_arena);
+    fprintf_allocator_stats(file, "block_arena", &c->block_arena);
+    fprintf_allocator_stats(file, "symbol_arena", &c->symbol_arena);
+    fprintf(file, "%-18s %6zu buckets available\n", "bucket pool", count_available_buckets());
+}
+
+// PARALLEL JOBS //
+
+typedef struct
+{
+    size_t worker;
+    size_t first_error;
+    size_t error_count;
+} JobErrors;
+
+typedef struct
+{
+    Compiler *workers;
+    JobErrors *job_errors;
+    CompilerJob function;
+    void *context;
+} CompilerJobs;
+
+void run_compiler_job(void *context, size_t worker, size_t job)
+{
+    CompilerJobs *jobs = (CompilerJobs *)context;
+    Compiler *c = &jobs->workers[worker];
+
+    size_t first_error = c->error_count;
+    jobs->function(c, jobs->context, job);
+
+    jobs->job_errors[job] = (JobErrors){
+        .worker = worker,
+        .first_error = first_error,
+        .error_count = c->error_count - first_error,
+    };
+}
+
+void run_compiler_jobs(Compiler *c, size_t job_count, CompilerJob function, void *context)
+{
+    run_compiler_jobs_or_discard(c, job_count, function, context, NULL);
+}
+
+bool run_compiler_jobs_or_discard(Compiler *c, size_t job_count, CompilerJob function, void *context, CompilerJobsCheck keep_results)
+{
+    size_t worker_count = get_processor_count();
+    if (worker_count > job_count)
+        worker_count = job_count;
+
+    // Results that might be discarded must not be allocated in the compiler's own arenas
+    if (keep_results ? job_count == 0 : !c->parallel_functions || worker_count <= 1)
+    {
+        for (size_t i = 0; i < job_count; i++)
+            function(c, context, i);
+        return true;
+    }
+
+    Compiler *workers = (Compiler *)malloc(sizeof(Compiler) * worker_count);
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        workers[i] = *c;
+        init_compiler_arenas(&workers[i]);
+
+        // Each worker claims its own chunks of the expression table
+        workers[i].next_expression = 0;
+        workers[i].expression_chunk_end = 0;
+
+        workers[i].error_capacity = 8;
+        workers[i].error_count = 0;
+        workers[i].errors = (CompilationError *)malloc(sizeof(CompilationError) * workers[i].error_capacity);
+    }
+
+    CompilerJobs jobs = {
+        .workers = workers,
+        .job_errors = (JobErrors *)malloc(sizeof(JobErrors) * job_count),
+        .function = function,
+        .context = context,
+    };
+    run_in_parallel(job_count, worker_count, run_compiler_job, (void *)&jobs);
+
+    bool keep = !keep_results || keep_results(context);
+    if (!keep)
+    {
+        for (size_t i = 0; i < worker_count; i++)
+        {
+            release_compiler_arenas(&workers[i]);
+            free(workers[i].errors);
+        }
+
+        free(jobs.job_errors);
+        free(workers);
+        return false;
+    }
+
+    // Merge errors in job order, which is the order a sequential pass would have raised them in
+    for (size_t i = 0; i < job_count; i++)
+    {
+        JobErrors job_errors = jobs.job_errors[i];
+        Compiler *worker = &workers[job_errors.worker];
+        for (size_t j = 0; j < job_errors.error_count; j++)
+        {
+            CompilationError error = worker->errors[job_errors.first_error + j];
+            raise_compilation_error(c, error.code, error.str);
+        }
+    }
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        merge_allocator(&c->apm_allocator, &workers[i].apm_allocator);
+        merge_allocator(&c->expression_arena, &workers[i].expression_arena);
+        merge_allocator(&c->list_arena, &workers[i].list_arena);
+        merge_allocator(&c->block_arena, &workers[i].block_arena);
+        merge_allocator(&c->symbol_arena, &workers[i].symbol_arena);
+        free(workers[i].errors);
+    }
+
+    free(jobs.job_errors);
+    free(workers);
+    return true;
+}
@@ -16,6 +16,7 @@
     MACRO(EXPECTED_STATEMENT)                                       \
                                                                     \
     MACRO(EXPECTED_VARIABLE_NAME)                                   \
+    MACRO(INTEGER_LITERAL_IS_TOO_LARGE)                             \
                                                                     \
     /* NOTE: These should be synced up to LIST_TOKENS in token.h */ \
     MACRO(EXPECTED_INVALID_TOKEN)                                   \
@@ -69,6 +70,7 @@
     /* RESOLVER AND CHECKER ERRORS */                               \
     MACRO(CONDITION_IS_NOT_BOOLEAN)                                 \
     MACRO(EXPRESSION_IS_NOT_A_FUNCTION)                             \
+    MACRO(GLOBAL_VARIABLE_DEPENDS_ON_ITSELF)                        \
     MACRO(NO_MAIN_FUNCTION)                                         \
     MACRO(RHS_TYPE_DOES_NOT_MATCH_LHS)                              \
     MACRO(SINGLETON_BLOCK_CANNOT_CONTAIN_DECLARATION)               \
@@ -89,6 +91,7 @@ typedef struct
     substr str;
     size_t line;
     size_t column;
+    size_t order; // The order errors were raised in, which breaks ties between errors at the same position
 } CompilationError;
 
 // Parser status
@@ -99,23 +102,75 @@ typedef struct
 
 DECLARE_ENUM(LIST_PARSE_STATUS, ParseStatus, parse_status)
 
+// Token stream
+typedef struct
+{
+    const char *next_character; // Where the tokeniser will continue from
+    bool ended;                 // Whether END_OF_FILE has been tokenised
+
+    // When threaded, the tokeniser runs ahead of the parser on its own thread
+    bool threaded;
+    Thread thread;
+    Mutex mutex;
+    Condition tokens_pushed;
+    Condition tokens_released;
+    bool parser_waiting;
+} TokenStream;
+
+// APM arenas
+// Each kind of APM node is allocated from its own arena, so passes that walk one kind of node touch
+// densely packed memory. The bucket sizes can be overridden at build time.
+#ifndef APM_ARENA_BUCKET_SIZE
+#define APM_ARENA_BUCKET_SIZE 4096
+#endif
+
+#ifndef EXPRESSION_ARENA_BUCKET_SIZE
+#define EXPRESSION_ARENA_BUCKET_SIZE 16384
+#endif
+
+#ifndef LIST_ARENA_BUCKET_SIZE
+#define LIST_ARENA_BUCKET_SIZE 8192
+#endif
+
+#ifndef BLOCK_ARENA_BUCKET_SIZE
+#define BLOCK_ARENA_BUCKET_SIZE 4096
+#endif
+
+#ifndef SYMBOL_ARENA_BUCKET_SIZE
+#define SYMBOL_ARENA_BUCKET_SIZE 8192
+#endif
+
 // Compiler
 typedef struct
 {
     // Source
     const char *source_path;
     const char *source_text;
+    SourceFile source_file;
+    SourceMap source_map;
 
     // Tokenize
-    // TokenArray
-    Token *tokens;
-    size_t token_capacity;
-    size_t token_count;
+    AtomTable atoms;
+    TokenArray tokens;
+    TokenStream *token_stream;   // NULL unless tokens are streamed to the parser
+    TokenStream stream;          // Where token_stream points while streaming
+    size_t tokenise_chunk_count; // If non-zero, the source is always split into this many chunks for tokenising
 
     // Parse
-    Allocator apm_allocator;
+    Allocator apm_allocator;    // Functions, types and variables
+    Allocator expression_arena; // Chunks of the expression table
+    Allocator list_arena;       // The contiguous arrays of APM lists
+    Allocator block_arena;      // Blocks
+    Allocator symbol_arena;     // Symbol tables and their symbols
     size_t next_token;
+    uint32_t next_expression;      // The next free index in the chunk of the program's expression table claimed by
+    uint32_t expression_chunk_end; // this compiler, see add_expressions
     ParseStatus parse_status;
+    bool parse_lazily;
+    Allocator *declared_types; // If set, declared types are recorded here to be interned later, see intern_declared_type
+
+    // Passes
+    bool parallel_functions; // Parse, resolve, check and assemble global declarations on a pool of threads
 
     // Errors
     CompilationError *errors;
@@ -124,6 +179,21 @@ typedef struct
 } Compiler;
 
 void init_compiler(Compiler *c);
+void release_compiler_arenas(Compiler *c);
+void reset_compiler(Compiler *c);
+void free_compiler(Compiler *c);
+void fprintf_compiler_memory(FILE *file, Compiler *c);
+
+// Run a job for each global declaration in parallel, when enabled
+// Each worker is given its own copy of the compiler, with its own arenas and errors. These are
+// merged back into the compiler afterwards, with errors kept in the order of the jobs that raised them.
+typedef void (*CompilerJob)(Compiler *c, void *context, size_t job);
+void run_compiler_jobs(Compiler *c, size_t job_count, CompilerJob function, void *context);
+
+// As above, but the jobs always run on copies of the compiler, which are only merged back if `keep_results`
+// returns true once every job has finished. Otherwise everything they allocated and raised is discarded.
+typedef bool (*CompilerJobsCheck)(void *context);
+bool run_compiler_jobs_or_discard(Compiler *c, size_t job_count, CompilerJob function, void *context, CompilerJobsCheck keep_results);
 
 void raise_compilation_error(Compiler *c, CompilationErrorCode code, substr str);
 void determine_error_positions(Compiler *c);
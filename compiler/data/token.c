@@ -1,3 +1,82 @@
 #include "token.h"
 
 DEFINE_ENUM(LIST_TOKENS, TokenKind, token_kind)
+
+void init_token_array(TokenArray *tokens, size_t capacity)
+{
+    tokens->capacity = 1;
+    while (tokens->capacity < capacity)
+        tokens->capacity *= 2;
+
+    tokens->kind = (uint8_t *)malloc(sizeof(uint8_t) * tokens->capacity);
+    tokens->pos = (uint32_t *)malloc(sizeof(uint32_t) * tokens->capacity);
+    tokens->len = (uint32_t *)malloc(sizeof(uint32_t) * tokens->capacity);
+    tokens->value = (TokenValue *)malloc(sizeof(TokenValue) * tokens->capacity);
+    tokens->count = 0;
+    tokens->first = 0;
+    tokens->retain_from = 0;
+}
+
+void free_token_array(TokenArray *tokens)
+{
+    free(tokens->kind);
+    free(tokens->pos);
+    free(tokens->len);
+    free(tokens->value);
+}
+
+bool is_token_array_full(TokenArray *tokens)
+{
+    return tokens->count - tokens->first == tokens->capacity;
+}
+
+// Discard tokens that are no longer needed, or grow the array if there are none
+void make_space_in_token_array(TokenArray *tokens)
+{
+    if (tokens->retain_from > tokens->first)
+        tokens->first = tokens->retain_from;
+    else
+        grow_token_array(tokens);
+}
+
+void grow_token_array(TokenArray *tokens)
+{
+    TokenArray grown;
+    init_token_array(&grown, tokens->capacity * 2);
+
+    for (size_t i = tokens->first; i < tokens->count; i++)
+    {
+        grown.kind[TOKEN_SLOT(&grown, i)] = tokens->kind[TOKEN_SLOT(tokens, i)];
+        grown.pos[TOKEN_SLOT(&grown, i)] = tokens->pos[TOKEN_SLOT(tokens, i)];
+        grown.len[TOKEN_SLOT(&grown, i)] = tokens->len[TOKEN_SLOT(tokens, i)];
+        grown.value[TOKEN_SLOT(&grown, i)] = tokens->value[TOKEN_SLOT(tokens, i)];
+    }
+
+    free_token_array(tokens);
+    tokens->kind = grown.kind;
+    tokens->pos = grown.pos;
+    tokens->len = grown.len;
+    tokens->value = grown.value;
+    tokens->capacity = grown.capacity;
+}
+
+void push_token(TokenArray *tokens, TokenKind kind, size_t pos, size_t len, TokenValue value)
+{
+    if (is_token_array_full(tokens))
+        make_space_in_token_array(tokens);
+
+    size_t slot = TOKEN_SLOT(tokens, tokens->count);
+    tokens->kind[slot] = (uint8_t)kind;
+    tokens->pos[slot] = (uint32_t)pos;
+    tokens->len[slot] = (uint32_t)len;
+    tokens->value[slot] = value;
+    tokens->count++;
+}
+
+substr get_token_str(TokenArray *tokens, size_t i)
+{
+    substr str;
+    str.pos = tokens->pos[TOKEN_SLOT(tokens, i)];
+    str.len = tokens->len[TOKEN_SLOT(tokens, i)];
+    return str;
+}
@@ -67,11 +67,41 @@
 
 DECLARE_ENUM(LIST_TOKENS, TokenKind, token_kind)
 
-// Token
+// Token value
+// Identities carry their interned atom, and numbers carry their value
+typedef union
+{
+    Atom atom;
+    int64_t integer;
+    double rational;
+} TokenValue;
+
+// Token array
+// Tokens are stored as a structure of arrays, so that the parser can look ahead at
+// token kinds without also loading the position and length of each token.
+//
+// The array is a ring buffer. When tokens are streamed, tokens before `retain_from` are
+// discarded to make space for new tokens, rather than growing the array.
 typedef struct
 {
-    TokenKind kind;
-    substr str;
-} Token;
+    uint8_t *kind; // TokenKind, of which there are fewer than 256
+    uint32_t *pos;
+    uint32_t *len;
+    TokenValue *value;
+    size_t count;       // Total number of tokens pushed to the array
+    size_t first;       // Index of the oldest token still stored in the array
+    size_t retain_from; // Tokens before this index are no longer needed
+    size_t capacity;    // Always a power of two
+} TokenArray;
+
+#define TOKEN_SLOT(tokens, i) ((i) & ((tokens)->capacity - 1))
+
+void init_token_array(TokenArray *tokens, size_t capacity);
+void free_token_array(TokenArray *tokens);
+bool is_token_array_full(TokenArray *tokens);
+void make_space_in_token_array(TokenArray *tokens);
+void grow_token_array(TokenArray *tokens);
+void push_token(TokenArray *tokens, TokenKind kind, size_t pos, size_t len, TokenValue value);
+substr get_token_str(TokenArray *tokens, size_t i);
 
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "../core/core.h"
 #include "../data/apm.h"
+#include "../data/compiler.h"
 #include <inttypes.h>
 
 typedef enum
@@ -66,80 +67,28 @@ void memmap_apm_bucket(Bucket *bucket)
     {
         add_mem_data((void *)bucket, sizeof(Bucket), MEM_META);
         add_mem_data((void *)bucket->data, bucket->head - bucket->data, MEM_UNKNOWN);
-        add_mem_data((void *)bucket->head, bucket->tail - bucket->head, MEM_WASTED);
+
+        // The space left at the end of the last bucket can still be allocated
+        add_mem_data((void *)bucket->head, bucket->tail - bucket->head, bucket->next ? MEM_WASTED : MEM_UNUSED);
         bucket = bucket->next;
     }
 }
 
-void memmap_expression(Expression *expr);
 void memmap_statement(Statement *stmt);
 void memmap_block(Block *block);
 void memmap_function(Function *funct);
 
-void memmap_expression(Expression *expr)
+// Expressions live in the chunks of the expression table, rather than in the tree of statements
+void memmap_expression_table(ExpressionTable *table)
 {
-    add_mem_data((void *)expr, sizeof(Expression), MEM_EXPRESSION);
+    add_mem_data((void *)table->chunks, sizeof(ExpressionChunk) * table->chunk_capacity, MEM_META);
 
-    switch (expr->kind)
+    for (size_t i = 0; i < table->chunk_count; i++)
     {
-    case IDENTITY_LITERAL:
-    case NONE_LITERAL:
-    case BOOLEAN_LITERAL:
-    case INTEGER_LITERAL:
-    case FLOAT_LITERAL:
-    case STRING_LITERAL:
-    case ENUM_VALUE_LITERAL:
-        break;
-
-    case VARIABLE_REFERENCE:
-    case FUNCTION_REFERENCE:
-    case PARAMETER_REFERENCE:
-    case TYPE_REFERENCE:
-        break;
-
-    case FUNCTION_CALL:
-        // TODO: memmap args
-        break;
-
-    case INDEX_BY_FIELD:
-        memmap_expression(expr->subject);
-        break;
-
-    case RANGE_LITERAL:
-        memmap_expression(expr->first);
-        memmap_expression(expr->last);
-        break;
-
-    case NONEABLE_EXPRESSION:
-
-    case UNARY_POS:
-    case UNARY_NEG:
-    case UNARY_NOT:
-    case UNARY_INCREMENT:
-    case UNARY_DECREMENT:
-        memmap_expression(expr->subject);
-        break;
-
-    case BINARY_MULTIPLY:
-    case BINARY_DIVIDE:
-    case BINARY_REMAINDER:
-    case BINARY_ADD:
-    case BINARY_SUBTRACT:
-    case BINARY_LESS_THAN:
-    case BINARY_GREATER_THAN:
-    case BINARY_LESS_THAN_EQUAL:
-    case BINARY_GREATER_THAN_EQUAL:
-    case BINARY_EQUAL:
-    case BINARY_NOT_EQUAL:
-    case BINARY_LOGICAL_AND:
-    case BINARY_LOGICAL_OR:
-        memmap_expression(expr->lhs);
-        memmap_expression(expr->rhs);
-        break;
-
-    case TYPE_CAST:
-        memmap_expression(expr->cast_expr);
-        break;
+        ExpressionChunk chunk = table->chunks[i];
+        for (size_t j = 0; j < EXPRESSION_CHUNK_SIZE; j++)
+            add_mem_data((void *)&chunk.expression[j], sizeof(Expression), MEM_EXPRESSION);
+        add_mem_data((void *)chunk.span, sizeof(substr) * EXPRESSION_CHUNK_SIZE, MEM_META);
     }
 }
 
@@ -161,50 +110,29 @@ void memmap_statement(Statement *stmt)
         add_mem_data((void *)stmt->struct_type, sizeof(StructType), MEM_TYPE);
         break;
 
-    case VARIABLE_DECLARATION:
-        if (stmt->initial_value)
-            memmap_expression(stmt->initial_value);
-        break;
-
     case CODE_BLOCK:
         memmap_block(stmt->block);
         break;
 
     case IF_SEGMENT:
     case ELSE_IF_SEGMENT:
-        memmap_expression(stmt->condition);
     case ELSE_SEGMENT:
         memmap_block(stmt->body);
         break;
 
     case WHILE_LOOP:
-        memmap_expression(stmt->condition);
     case BREAK_LOOP:
     case FOR_LOOP:
         memmap_block(stmt->body);
         break;
 
-    case BREAK_STATEMENT:
-        break;
-
-    case ASSIGNMENT_STATEMENT:
-        memmap_expression(stmt->assignment_lhs);
-        memmap_expression(stmt->assignment_rhs);
-        break;
-
-    case OUTPUT_STATEMENT:
-    case EXPRESSION_STMT:
-    case RETURN_STATEMENT:
-        if (stmt->expression)
-            memmap_expression(stmt->expression);
+    default:
         break;
     }
 }
 
 void memmap_block(Block *block)
 {
-    memmap_apm_bucket(block->statements.bucket);
-
     add_mem_data((void *)block, sizeof(Block), MEM_BLOCK);
 
     Statement *stmt;
@@ -217,10 +145,11 @@ void memmap_function(Function *funct)
 {
     add_mem_data((void *)funct, sizeof(Function), MEM_FUNCTION);
 
-    memmap_block(funct->body);
+    if (funct->body)
+        memmap_block(funct->body);
 }
 
-void memmap(Program *apm, Allocator apm_allocator)
+void memmap(Program *apm, Compiler *c)
 {
     Memmap.count = 0;
     Memmap.capacity = 128;
@@ -239,8 +168,18 @@ void memmap(Program *apm, Allocator apm_allocator)
     }
 
     // Walk apm
-    memmap_apm_bucket(apm_allocator.first);
+    memmap_apm_bucket(c->apm_allocator.first);
+    memmap_apm_bucket(c->expression_arena.first);
+    memmap_apm_bucket(c->list_arena.first);
+    memmap_apm_bucket(c->block_arena.first);
+    memmap_apm_bucket(c->symbol_arena.first);
+    memmap_apm_bucket(c->apm_allocator.large);
+    memmap_apm_bucket(c->expression_arena.large);
+    memmap_apm_bucket(c->list_arena.large);
+    memmap_apm_bucket(c->block_arena.large);
+    memmap_apm_bucket(c->symbol_arena.large);
     memmap_block(apm->program_block);
+    memmap_expression_table(&apm->expressions);
 
     // Align data to 0
     for (size_t i = 0; i < Memmap.count; i++)
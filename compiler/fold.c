@@ -0,0 +1,1002 @@
+#include "fold.h"
+
+#include <math.h>
+
+// CONSTANT VALUES //
+// Values are evaluated with the same semantics as the interpreter, i.e. ints and nums are both
+// represented as doubles, and any value that is not `false` or `none` is truthy.
+
+#define FOLD_STEP_BUDGET 10000
+#define FOLD_MAX_CALL_DEPTH 64
+#define FOLD_MAX_BINDINGS 1024
+
+typedef enum
+{
+    CONST_NONE,
+    CONST_BOOL,
+    CONST_NUM,
+} ConstKind;
+
+typedef struct
+{
+    ConstKind kind;
+    union
+    {
+        bool as_bool;
+        double as_num;
+    };
+} ConstValue;
+
+#define CONST_NONE_VALUE() ((ConstValue){.kind = CONST_NONE, .as_num = 0})
+#define CONST_BOOL_VALUE(value) ((ConstValue){.kind = CONST_BOOL, .as_bool = value})
+#define CONST_NUM_VALUE(value) ((ConstValue){.kind = CONST_NUM, .as_num = value})
+
+// Whether a num is a whole number that fits in an int literal
+// NOTE: Converting a double outside of the range of int64_t is undefined, so the range is checked first
+bool is_whole_number(double value)
+{
+    return value >= -9223372036854775808.0 && value < 9223372036854775808.0 && value == (double)(int64_t)value;
+}
+
+// CONSTANT GLOBALS //
+// A global variable that is initialised to a literal and never assigned to has the same value
+// for the whole program, and so can be read during evaluation.
+
+typedef struct
+{
+    Variable *variable;
+    ConstValue value;
+    bool has_value;
+    bool is_assigned;
+} ConstantGlobal;
+
+typedef struct
+{
+    Allocator allocator;
+    ConstantGlobal *slot; // Open addressed hash table, keyed by variable
+    size_t count;
+    size_t capacity;
+} ConstantGlobals;
+
+#define INITIAL_CONSTANT_GLOBALS_CAPACITY 64
+
+size_t constant_global_slot(ConstantGlobals *globals, Variable *variable)
+{
+    size_t hash = ((size_t)variable >> 3) * 2654435769u;
+    size_t i = (hash ^ (hash >> 16)) & (globals->capacity - 1);
+    while (globals->slot[i].variable && globals->slot[i].variable != variable)
+        i = (i + 1) & (globals->capacity - 1);
+    return i;
+}
+
+ConstantGlobal *find_constant_global(ConstantGlobals *globals, Variable *variable)
+{
+    if (globals->count == 0)
+        return NULL;
+
+    ConstantGlobal *global = &globals->slot[constant_global_slot(globals, variable)];
+    return global->variable ? global : NULL;
+}
+
+void add_constant_global(ConstantGlobals *globals, Variable *variable)
+{
+    // Keep the load factor at or below three quarters
+    if ((globals->count + 1) * 4 > globals->capacity * 3)
+    {
+        ConstantGlobal *old_slot = globals->slot;
+        size_t old_capacity = globals->capacity;
+
+        globals->capacity = old_capacity == 0 ? INITIAL_CONSTANT_GLOBALS_CAPACITY : old_capacity * 2;
+        globals->slot = (ConstantGlobal *)allocate_chunk(&globals->allocator, sizeof(ConstantGlobal) * globals->capacity, alignof(ConstantGlobal));
+        memset(globals->slot, 0, sizeof(ConstantGlobal) * globals->capacity);
+
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            if (old_slot[i].variable)
+                globals->slot[constant_global_slot(globals, old_slot[i].variable)] = old_slot[i];
+        }
+    }
+
+    ConstantGlobal *global = &globals->slot[constant_global_slot(globals, variable)];
+    if (global->variable)
+        return;
+
+    global->variable = variable;
+    global->has_value = false;
+    global->is_assigned = false;
+    globals->count++;
+}
+
+ConstValue *lookup_constant_global(ConstantGlobals *globals, Variable *variable)
+{
+    ConstantGlobal *global = find_constant_global(globals, variable);
+    if (!global || !global->has_value || global->is_assigned)
+        return NULL;
+
+    return &global->value;
+}
+
+// FRAMES //
+// Each function call made during evaluation has its own frame that binds its
+// parameters and local variables. Frames are windows onto a single stack of
+// bindings owned by the evaluator, and each call's frame starts at the top of it.
+// Any node that is not bound in the current frame and is not a constant global
+// (e.g. a variable captured by a nested function) cannot be evaluated at compile time.
+
+typedef struct
+{
+    void *node;
+    ConstValue value;
+} Binding;
+
+typedef struct
+{
+    Binding *binding;
+    size_t binding_count;
+} Frame;
+
+typedef struct
+{
+    size_t steps_left;
+    size_t call_depth;
+    ConstantGlobals *globals;
+
+    Binding stack[FOLD_MAX_BINDINGS];
+    Binding *top; // The first binding not used by any frame
+} Evaluator;
+
+ConstValue *lookup_binding(Frame *frame, void *node)
+{
+    // Search backwards so that the most recent declaration is found first
+    for (size_t i = frame->binding_count; i > 0; i--)
+        if (frame->binding[i - 1].node == node)
+            return &frame->binding[i - 1].value;
+
+    return NULL;
+}
+
+// NOTE: Only the frame at the top of the stack can bind new nodes
+bool bind(Evaluator *e, Frame *frame, void *node, ConstValue value)
+{
+    assert(frame->binding + frame->binding_count == e->top);
+    if (e->top == e->stack + FOLD_MAX_BINDINGS)
+        return false;
+
+    *e->top++ = (Binding){
+        .node = node,
+        .value = value,
+    };
+    frame->binding_count++;
+    return true;
+}
+
+// Forget bindings made since the frame had `binding_count` bindings
+void unbind(Evaluator *e, Frame *frame, size_t binding_count)
+{
+    frame->binding_count = binding_count;
+    e->top = frame->binding + binding_count;
+}
+
+bool is_truthy(ConstValue value)
+{
+    return !((value.kind == CONST_BOOL && value.as_bool == false) || value.kind == CONST_NONE);
+}
+
+bool are_const_values_equal(ConstValue a, ConstValue b)
+{
+    if (a.kind != b.kind)
+        return false;
+
+    if (a.kind == CONST_BOOL)
+        return a.as_bool == b.as_bool;
+
+    if (a.kind == CONST_NUM)
+        return memcmp(&a.as_num, &b.as_num, sizeof(double)) == 0;
+
+    return true;
+}
+
+// EVALUATE //
+
+typedef enum
+{
+    EXEC_FAILED,
+    EXEC_CONTINUE,
+    EXEC_BREAK,
+    EXEC_RETURN,
+} ExecStatus;
+
+bool evaluate_expression(Evaluator *e, Program *apm, Frame *frame, ExpressionIndex index, ConstValue *result);
+bool evaluate_call(Evaluator *e, Program *apm, Frame *frame, ExpressionIndex index, ConstValue *result);
+ExecStatus execute_block(Evaluator *e, Program *apm, Frame *frame, Block *block, ConstValue *return_value);
+
+bool take_step(Evaluator *e)
+{
+    if (e->steps_left == 0)
+        return false;
+
+    e->steps_left--;
+    return true;
+}
+
+bool evaluate_expression(Evaluator *e, Program *apm, Frame *frame, ExpressionIndex index, ConstValue *result)
+{
+    if (!take_step(e))
+        return false;
+
+    Expression *expr = get_expression(apm, index);
+    switch (expr->kind)
+    {
+    case NONE_LITERAL:
+        *result = CONST_NONE_VALUE();
+        return true;
+
+    case BOOLEAN_LITERAL:
+        *result = CONST_BOOL_VALUE(expr->bool_value);
+        return true;
+
+    case INTEGER_LITERAL:
+        *result = CONST_NUM_VALUE((double)expr->integer_value);
+        return true;
+
+    case FLOAT_LITERAL:
+        *result = CONST_NUM_VALUE(expr->float_value);
+        return true;
+
+    case VARIABLE_REFERENCE:
+    case PARAMETER_REFERENCE:
+    {
+        ConstValue *value = NULL;
+        if (frame)
+            value = lookup_binding(frame, expr->kind == VARIABLE_REFERENCE ? (void *)expr->variable : (void *)expr->parameter);
+        if (!value && expr->kind == VARIABLE_REFERENCE)
+            value = lookup_constant_global(e->globals, expr->variable);
+        if (!value)
+            return false;
+
+        *result = *value;
+        return true;
+    }
+
+    case FUNCTION_CALL:
+        return evaluate_call(e, apm, frame, index, result);
+
+    case UNARY_POS:
+        return evaluate_expression(e, apm, frame, expr->operand, result);
+
+    case UNARY_NEG:
+    {
+        ConstValue operand;
+        if (!evaluate_expression(e, apm, frame, expr->operand, &operand) || operand.kind != CONST_NUM)
+            return false;
+
+        *result = CONST_NUM_VALUE(-operand.as_num);
+        return true;
+    }
+
+    case UNARY_NOT:
+    {
+        ConstValue operand;
+        if (!evaluate_expression(e, apm, frame, expr->operand, &operand) || operand.kind != CONST_BOOL)
+            return false;
+
+        *result = CONST_BOOL_VALUE(!operand.as_bool);
+        return true;
+    }
+
+    case UNARY_INCREMENT:
+    case UNARY_DECREMENT:
+    {
+        Expression *operand = get_expression(apm, expr->operand);
+        if (!frame || (operand->kind != VARIABLE_REFERENCE && operand->kind != PARAMETER_REFERENCE))
+            return false;
+
+        ConstValue *value = lookup_binding(frame, operand->kind == VARIABLE_REFERENCE ? (void *)operand->variable : (void *)operand->parameter);
+        if (!value || value->kind != CONST_NUM)
+            return false;
+
+        *result = *value;
+        value->as_num += expr->kind == UNARY_INCREMENT ? 1 : -1;
+        return true;
+    }
+
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_REMAINDER:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_LESS_THAN:
+    case BINARY_GREATER_THAN:
+    case BINARY_LESS_THAN_EQUAL:
+    case BINARY_GREATER_THAN_EQUAL:
+    case BINARY_EQUAL:
+    case BINARY_NOT_EQUAL:
+    case BINARY_LOGICAL_AND:
+    case BINARY_LOGICAL_OR:
+    {
+        ConstValue lhs, rhs;
+        if (!evaluate_expression(e, apm, frame, expr->lhs, &lhs))
+            return false;
+        if (!evaluate_expression(e, apm, frame, expr->rhs, &rhs))
+            return false;
+
+        if (expr->kind == BINARY_EQUAL || expr->kind == BINARY_NOT_EQUAL)
+        {
+            bool equal = are_const_values_equal(lhs, rhs);
+            *result = CONST_BOOL_VALUE(expr->kind == BINARY_EQUAL ? equal : !equal);
+            return true;
+        }
+
+        if (expr->kind == BINARY_LOGICAL_AND || expr->kind == BINARY_LOGICAL_OR)
+        {
+            if (lhs.kind != CONST_BOOL || rhs.kind != CONST_BOOL)
+                return false;
+
+            if (expr->kind == BINARY_LOGICAL_AND)
+                *result = CONST_BOOL_VALUE(lhs.as_bool && rhs.as_bool);
+            else
+                *result = CONST_BOOL_VALUE(lhs.as_bool || rhs.as_bool);
+            return true;
+        }
+
+        if (lhs.kind != CONST_NUM || rhs.kind != CONST_NUM)
+            return false;
+
+        double a = lhs.as_num;
+        double b = rhs.as_num;
+
+        switch (expr->kind)
+        {
+        case BINARY_MULTIPLY:
+            *result = CONST_NUM_VALUE(a * b);
+            return true;
+
+        case BINARY_DIVIDE:
+            *result = CONST_NUM_VALUE(a / b);
+            return true;
+
+        case BINARY_ADD:
+            *result = CONST_NUM_VALUE(a + b);
+            return true;
+
+        case BINARY_SUBTRACT:
+            *result = CONST_NUM_VALUE(a - b);
+            return true;
+
+        // The interpreter only supports the remainder of positive numbers, and computes it by
+        // repeated subtraction. For whole numbers this gives the same result as fmod.
+        case BINARY_REMAINDER:
+            if (!(a > 0 && b > 0) || !is_whole_number(a) || !is_whole_number(b))
+                return false;
+            *result = CONST_NUM_VALUE(fmod(a, b));
+            return true;
+
+        case BINARY_LESS_THAN:
+            *result = CONST_BOOL_VALUE(a < b);
+            return true;
+
+        case BINARY_GREATER_THAN:
+            *result = CONST_BOOL_VALUE(b < a);
+            return true;
+
+        case BINARY_LESS_THAN_EQUAL:
+            *result = CONST_BOOL_VALUE(a <= b);
+            return true;
+
+        case BINARY_GREATER_THAN_EQUAL:
+            *result = CONST_BOOL_VALUE(b <= a);
+            return true;
+
+        default:
+            unreachable;
+        }
+    }
+
+    // Strings, enum values, structs, etc are not evaluated at compile time
+    default:
+        return false;
+    }
+}
+
+bool evaluate_call(Evaluator *e, Program *apm, Frame *frame, ExpressionIndex index, ConstValue *result)
+{
+    Expression *expr = get_expression(apm, index);
+    Expression *callee = get_expression(apm, expr->callee);
+    if (callee->kind != FUNCTION_REFERENCE)
+        return false;
+
+    Function *funct = callee->function;
+    if (funct->parameters.count != expr->argument_count)
+        return false;
+
+    if (e->call_depth == FOLD_MAX_CALL_DEPTH)
+        return false;
+
+    // Arguments are evaluated in the caller's frame, and bound one by one in the callee's frame
+    Frame callee_frame = {.binding = e->top, .binding_count = 0};
+
+    bool success = true;
+    for (size_t i = 0; i < expr->argument_count && success; i++)
+    {
+        ConstValue arg;
+        success = evaluate_expression(e, apm, frame, get_argument(apm, index, i), &arg) &&
+                  bind(e, &callee_frame, (void *)get_parameter(&funct->parameters, i), arg);
+    }
+
+    if (success)
+    {
+        e->call_depth++;
+        ConstValue return_value = CONST_NONE_VALUE();
+        ExecStatus status = execute_block(e, apm, &callee_frame, funct->body, &return_value);
+        e->call_depth--;
+
+        success = status == EXEC_CONTINUE || status == EXEC_RETURN;
+        *result = return_value;
+    }
+
+    unbind(e, &callee_frame, 0);
+    return success;
+}
+
+ExecStatus execute_block(Evaluator *e, Program *apm, Frame *frame, Block *block, ConstValue *return_value)
+{
+    // Variables declared in this block go out of scope at the end of it
+    size_t binding_count = frame->binding_count;
+    ExecStatus status = EXEC_CONTINUE;
+
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (status == EXEC_CONTINUE && (stmt = advance_iterator_of(&it, Statement)))
+    {
+        if (!take_step(e))
+        {
+            status = EXEC_FAILED;
+            break;
+        }
+
+        switch (stmt->kind)
+        {
+        case FUNCTION_DECLARATION:
+        case ENUM_TYPE_DECLARATION:
+        case STRUCT_TYPE_DECLARATION:
+            break;
+
+        case VARIABLE_DECLARATION:
+        {
+            ConstValue value;
+            RhinoType ty = stmt->variable->type;
+
+            if (stmt->initial_value)
+            {
+                if (!evaluate_expression(e, apm, frame, stmt->initial_value, &value))
+                    status = EXEC_FAILED;
+            }
+            else if (get_type_info(apm, ty)->is_noneable)
+                value = CONST_NONE_VALUE();
+            else if (IS_BOOL_TYPE(ty))
+                value = CONST_BOOL_VALUE(false);
+            else if (IS_INT_TYPE(ty) || IS_NUM_TYPE(ty))
+                value = CONST_NUM_VALUE(0);
+            else
+                status = EXEC_FAILED;
+
+            if (status != EXEC_FAILED && !bind(e, frame, (void *)stmt->variable, value))
+                status = EXEC_FAILED;
+
+            break;
+        }
+
+        case CODE_BLOCK:
+            status = execute_block(e, apm, frame, stmt->block, return_value);
+            break;
+
+        case IF_SEGMENT:
+        {
+            Statement *segment = stmt;
+            while (segment)
+            {
+                if (segment->kind == ELSE_SEGMENT)
+                {
+                    status = execute_block(e, apm, frame, segment->body, return_value);
+                    break;
+                }
+
+                ConstValue condition;
+                if (!evaluate_expression(e, apm, frame, segment->condition, &condition))
+                {
+                    status = EXEC_FAILED;
+                    break;
+                }
+
+                if (is_truthy(condition))
+                {
+                    status = execute_block(e, apm, frame, segment->body, return_value);
+                    break;
+                }
+
+                segment = segment->next;
+            }
+            break;
+        }
+
+        case ELSE_IF_SEGMENT:
+        case ELSE_SEGMENT:
+            break;
+
+        case BREAK_LOOP:
+        case WHILE_LOOP:
+        case FOR_LOOP:
+        {
+            ConstValue *iterator = NULL;
+            double last = 0;
+
+            if (stmt->kind == FOR_LOOP)
+            {
+                Expression *iterable = get_expression(apm, stmt->iterable);
+                if (iterable->kind != RANGE_LITERAL)
+                {
+                    status = EXEC_FAILED;
+                    break;
+                }
+
+                ConstValue first_value, last_value;
+                if (!evaluate_expression(e, apm, frame, iterable->first, &first_value) ||
+                    !evaluate_expression(e, apm, frame, iterable->last, &last_value) ||
+                    first_value.kind != CONST_NUM || last_value.kind != CONST_NUM ||
+                    !bind(e, frame, (void *)stmt->iterator, first_value))
+                {
+                    status = EXEC_FAILED;
+                    break;
+                }
+
+                iterator = lookup_binding(frame, (void *)stmt->iterator);
+                last = last_value.as_num;
+            }
+
+            while (true)
+            {
+                if (stmt->kind == WHILE_LOOP)
+                {
+                    ConstValue condition;
+                    if (!evaluate_expression(e, apm, frame, stmt->condition, &condition))
+                    {
+                        status = EXEC_FAILED;
+                        break;
+                    }
+
+                    if (!is_truthy(condition))
+                        break;
+                }
+                else if (stmt->kind == FOR_LOOP)
+                {
+                    if (!(iterator->as_num <= last))
+                        break;
+                }
+
+                if (!take_step(e))
+                {
+                    status = EXEC_FAILED;
+                    break;
+                }
+
+                status = execute_block(e, apm, frame, stmt->body, return_value);
+                if (status != EXEC_CONTINUE)
+                    break;
+
+                if (stmt->kind == FOR_LOOP)
+                    iterator->as_num += 1;
+            }
+
+            if (status == EXEC_BREAK)
+                status = EXEC_CONTINUE;
+
+            break;
+        }
+
+        case BREAK_STATEMENT:
+            status = EXEC_BREAK;
+            break;
+
+        case ASSIGNMENT_STATEMENT:
+        {
+            Expression *lhs = get_expression(apm, stmt->assignment_lhs);
+            ConstValue *target = NULL;
+            if (lhs->kind == VARIABLE_REFERENCE)
+                target = lookup_binding(frame, (void *)lhs->variable);
+            else if (lhs->kind == PARAMETER_REFERENCE)
+                target = lookup_binding(frame, (void *)lhs->parameter);
+
+            ConstValue value;
+            if (!target || !evaluate_expression(e, apm, frame, stmt->assignment_rhs, &value))
+            {
+                status = EXEC_FAILED;
+                break;
+            }
+
+            *target = value;
+            break;
+        }
+
+        // Output is a side effect, and so can never happen at compile time
+        case OUTPUT_STATEMENT:
+            status = EXEC_FAILED;
+            break;
+
+        case EXPRESSION_STMT:
+        {
+            ConstValue discard;
+            if (!evaluate_expression(e, apm, frame, stmt->expression, &discard))
+                status = EXEC_FAILED;
+            break;
+        }
+
+        case RETURN_STATEMENT:
+        {
+            *return_value = CONST_NONE_VALUE();
+            if (stmt->expression && !evaluate_expression(e, apm, frame, stmt->expression, return_value))
+                status = EXEC_FAILED;
+            else
+                status = EXEC_RETURN;
+            break;
+        }
+
+        default:
+            status = EXEC_FAILED;
+            break;
+        }
+    }
+
+    unbind(e, frame, binding_count);
+    return status;
+}
+
+// FIND ASSIGNMENTS //
+// Constant globals can not be assigned to anywhere in the program, including by increments
+
+void find_assignments_in_expression(ConstantGlobals *globals, Program *apm, ExpressionIndex index);
+void find_assignments_in_block(ConstantGlobals *globals, Program *apm, Block *block);
+
+void mark_assigned(ConstantGlobals *globals, Program *apm, ExpressionIndex index)
+{
+    Expression *target = get_expression(apm, index);
+    if (target->kind != VARIABLE_REFERENCE)
+        return;
+
+    ConstantGlobal *global = find_constant_global(globals, target->variable);
+    if (global)
+        global->is_assigned = true;
+}
+
+void find_assignments_in_expression(ConstantGlobals *globals, Program *apm, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    switch (expr->kind)
+    {
+    case FUNCTION_CALL:
+    {
+        find_assignments_in_expression(globals, apm, expr->callee);
+
+        for (size_t i = 0; i < expr->argument_count; i++)
+            find_assignments_in_expression(globals, apm, get_argument(apm, index, i));
+        break;
+    }
+
+    case INDEX_BY_FIELD:
+        find_assignments_in_expression(globals, apm, expr->subject);
+        break;
+
+    case RANGE_LITERAL:
+        find_assignments_in_expression(globals, apm, expr->first);
+        find_assignments_in_expression(globals, apm, expr->last);
+        break;
+
+    case TYPE_CAST:
+        find_assignments_in_expression(globals, apm, expr->cast_expr);
+        break;
+
+    case UNARY_INCREMENT:
+    case UNARY_DECREMENT:
+        mark_assigned(globals, apm, expr->operand);
+        find_assignments_in_expression(globals, apm, expr->operand);
+        break;
+
+    case UNARY_POS:
+    case UNARY_NEG:
+    case UNARY_NOT:
+        find_assignments_in_expression(globals, apm, expr->operand);
+        break;
+
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_REMAINDER:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_LESS_THAN:
+    case BINARY_GREATER_THAN:
+    case BINARY_LESS_THAN_EQUAL:
+    case BINARY_GREATER_THAN_EQUAL:
+    case BINARY_EQUAL:
+    case BINARY_NOT_EQUAL:
+    case BINARY_LOGICAL_AND:
+    case BINARY_LOGICAL_OR:
+        find_assignments_in_expression(globals, apm, expr->lhs);
+        find_assignments_in_expression(globals, apm, expr->rhs);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void find_assignments_in_block(ConstantGlobals *globals, Program *apm, Block *block)
+{
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        switch (stmt->kind)
+        {
+        case FUNCTION_DECLARATION:
+            if (stmt->function->body)
+                find_assignments_in_block(globals, apm, stmt->function->body);
+            break;
+
+        case VARIABLE_DECLARATION:
+            if (stmt->initial_value)
+                find_assignments_in_expression(globals, apm, stmt->initial_value);
+            break;
+
+        case CODE_BLOCK:
+            find_assignments_in_block(globals, apm, stmt->block);
+            break;
+
+        case IF_SEGMENT:
+        case ELSE_IF_SEGMENT:
+        case WHILE_LOOP:
+            find_assignments_in_expression(globals, apm, stmt->condition);
+            find_assignments_in_block(globals, apm, stmt->body);
+            break;
+
+        case ELSE_SEGMENT:
+        case BREAK_LOOP:
+            find_assignments_in_block(globals, apm, stmt->body);
+            break;
+
+        case FOR_LOOP:
+            find_assignments_in_expression(globals, apm, stmt->iterable);
+            find_assignments_in_block(globals, apm, stmt->body);
+            break;
+
+        case ASSIGNMENT_STATEMENT:
+            mark_assigned(globals, apm, stmt->assignment_lhs);
+            find_assignments_in_expression(globals, apm, stmt->assignment_lhs);
+            find_assignments_in_expression(globals, apm, stmt->assignment_rhs);
+            break;
+
+        case OUTPUT_STATEMENT:
+        case EXPRESSION_STMT:
+        case RETURN_STATEMENT:
+            if (stmt->expression)
+                find_assignments_in_expression(globals, apm, stmt->expression);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// FOLD //
+// Expressions are folded bottom-up, so that an expression is only evaluated once all of it's
+// operands have been folded into literals. Function calls are evaluated within a step budget.
+
+bool is_literal(Expression *expr)
+{
+    return expr->kind == NONE_LITERAL ||
+           expr->kind == BOOLEAN_LITERAL ||
+           expr->kind == INTEGER_LITERAL ||
+           expr->kind == FLOAT_LITERAL;
+}
+
+bool is_constant(Evaluator *e, Program *apm, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    return is_literal(expr) || (expr->kind == VARIABLE_REFERENCE && lookup_constant_global(e->globals, expr->variable));
+}
+
+void fold_expression(Compiler *c, Program *apm, Evaluator *e, ExpressionIndex index);
+void fold_block(Compiler *c, Program *apm, Evaluator *e, Block *block);
+
+void fold_expression(Compiler *c, Program *apm, Evaluator *e, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    bool operands_are_literals = true;
+
+    switch (expr->kind)
+    {
+    case FUNCTION_CALL:
+    {
+        for (size_t i = 0; i < expr->argument_count; i++)
+        {
+            ExpressionIndex arg = get_argument(apm, index, i);
+            fold_expression(c, apm, e, arg);
+            operands_are_literals = operands_are_literals && is_constant(e, apm, arg);
+        }
+        break;
+    }
+
+    case RANGE_LITERAL:
+        fold_expression(c, apm, e, expr->first);
+        fold_expression(c, apm, e, expr->last);
+        return;
+
+    case TYPE_CAST:
+        fold_expression(c, apm, e, expr->cast_expr);
+        return;
+
+    case UNARY_POS:
+    case UNARY_NEG:
+    case UNARY_NOT:
+        fold_expression(c, apm, e, expr->operand);
+        operands_are_literals = is_constant(e, apm, expr->operand);
+        break;
+
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_REMAINDER:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_LESS_THAN:
+    case BINARY_GREATER_THAN:
+    case BINARY_LESS_THAN_EQUAL:
+    case BINARY_GREATER_THAN_EQUAL:
+    case BINARY_EQUAL:
+    case BINARY_NOT_EQUAL:
+    case BINARY_LOGICAL_AND:
+    case BINARY_LOGICAL_OR:
+        fold_expression(c, apm, e, expr->lhs);
+        fold_expression(c, apm, e, expr->rhs);
+        operands_are_literals = is_constant(e, apm, expr->lhs) && is_constant(e, apm, expr->rhs);
+        break;
+
+    // References to constant globals are replaced with their values
+    case VARIABLE_REFERENCE:
+        operands_are_literals = lookup_constant_global(e->globals, expr->variable) != NULL;
+        break;
+
+    default:
+        return;
+    }
+
+    if (!operands_are_literals)
+        return;
+
+    e->steps_left = FOLD_STEP_BUDGET;
+    e->call_depth = 0;
+    e->top = e->stack;
+
+    ConstValue value;
+    if (!evaluate_expression(e, apm, NULL, index, &value))
+        return;
+
+    // Replace the expression with a literal of the same type
+    RhinoType ty = expr->resolved_type;
+
+    if (value.kind == CONST_NONE)
+    {
+        expr->kind = NONE_LITERAL;
+    }
+    else if (value.kind == CONST_BOOL)
+    {
+        expr->kind = BOOLEAN_LITERAL;
+        expr->bool_value = value.as_bool;
+    }
+    else if (IS_INT_TYPE(ty) && is_whole_number(value.as_num))
+    {
+        expr->kind = INTEGER_LITERAL;
+        expr->integer_value = (int64_t)value.as_num;
+    }
+    else
+    {
+        expr->kind = FLOAT_LITERAL;
+        expr->float_value = value.as_num;
+    }
+}
+
+void fold_block(Compiler *c, Program *apm, Evaluator *e, Block *block)
+{
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        switch (stmt->kind)
+        {
+        case FUNCTION_DECLARATION:
+            if (stmt->function->body)
+                fold_block(c, apm, e, stmt->function->body);
+            break;
+
+        case VARIABLE_DECLARATION:
+            if (stmt->initial_value)
+                fold_expression(c, apm, e, stmt->initial_value);
+            break;
+
+        case CODE_BLOCK:
+            fold_block(c, apm, e, stmt->block);
+            break;
+
+        case IF_SEGMENT:
+        case ELSE_IF_SEGMENT:
+        case WHILE_LOOP:
+            fold_expression(c, apm, e, stmt->condition);
+            fold_block(c, apm, e, stmt->body);
+            break;
+
+        case ELSE_SEGMENT:
+        case BREAK_LOOP:
+            fold_block(c, apm, e, stmt->body);
+            break;
+
+        case FOR_LOOP:
+            fold_expression(c, apm, e, stmt->iterable);
+            fold_block(c, apm, e, stmt->body);
+            break;
+
+        case ASSIGNMENT_STATEMENT:
+            fold_expression(c, apm, e, stmt->assignment_rhs);
+            break;
+
+        case OUTPUT_STATEMENT:
+        case EXPRESSION_STMT:
+        case RETURN_STATEMENT:
+            if (stmt->expression)
+                fold_expression(c, apm, e, stmt->expression);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void fold(Compiler *c, Program *apm)
+{
+    Block *program_block = apm->program_block;
+
+    // The evaluator holds the stack of bindings, and so is too large to put on the stack
+    Evaluator *e = (Evaluator *)malloc(sizeof(Evaluator));
+    ConstantGlobals globals;
+    init_allocator(&globals.allocator);
+    globals.slot = NULL;
+    globals.count = 0;
+    globals.capacity = 0;
+    e->globals = &globals;
+
+    for (size_t i = 0; i < program_block->initialiser_count; i++)
+        add_constant_global(&globals, program_block->initialisers[i]->variable);
+    find_assignments_in_block(&globals, apm, program_block);
+
+    // Fold initial values in the order they are initialised in, so a global's value is known before it is read
+    for (size_t i = 0; i < program_block->initialiser_count; i++)
+    {
+        Statement *stmt = program_block->initialisers[i];
+        if (!stmt->initial_value)
+            continue;
+
+        fold_expression(c, apm, e, stmt->initial_value);
+
+        ConstantGlobal *global = find_constant_global(&globals, stmt->variable);
+        if (global->is_assigned || !is_literal(get_expression(apm, stmt->initial_value)))
+            continue;
+
+        // NOTE: None values are left for the assembler, as a none literal does not have the variable's type
+        e->top = e->stack;
+        if (evaluate_expression(e, apm, NULL, stmt->initial_value, &global->value) && global->value.kind != CONST_NONE)
+            global->has_value = true;
+    }
+
+    fold_block(c, apm, e, program_block);
+
+    release_allocator(&globals.allocator);
+    free(e);
+}
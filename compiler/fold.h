@@ -0,0 +1,10 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "core/core.h"
+#include "data/apm.h"
+#include "data/compiler.h"
+
+void fold(Compiler *compiler, Program *apm);
+
+#endif
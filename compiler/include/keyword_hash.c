@@ -0,0 +1,53 @@
+// This file was generated automatically by build_program/build.py
+
+typedef struct
+{
+	const char *word;
+	size_t len;
+	TokenKind kind;
+} KeywordSlot;
+
+KeywordSlot keyword_slot[32] = {
+	{"fn", 2, KEYWORD_FN},
+	{"", 0, IDENTITY},
+	{"in", 2, KEYWORD_IN},
+	{"true", 4, KEYWORD_TRUE},
+	{"struct", 6, KEYWORD_STRUCT},
+	{"and", 3, KEYWORD_AND},
+	{"while", 5, KEYWORD_WHILE},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"if", 2, KEYWORD_IF},
+	{"", 0, IDENTITY},
+	{"return", 6, KEYWORD_RETURN},
+	{"for", 3, KEYWORD_FOR},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"false", 5, KEYWORD_FALSE},
+	{"enum", 4, KEYWORD_ENUM},
+	{"or", 2, KEYWORD_OR},
+	{"not", 3, KEYWORD_NOT},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"", 0, IDENTITY},
+	{"else", 4, KEYWORD_ELSE},
+	{"break", 5, KEYWORD_BREAK},
+	{"", 0, IDENTITY},
+	{"loop", 4, KEYWORD_LOOP},
+	{"def", 3, KEYWORD_DEF},
+	{"", 0, IDENTITY},
+	{"none", 4, KEYWORD_NONE},
+};
+
+// Returns the kind of keyword that the word is, or IDENTITY if it is not a keyword
+TokenKind get_keyword_kind(const char *word, size_t len)
+{
+	size_t hash = (len * 1 + (uint8_t)word[0] * 22 + (uint8_t)word[len - 1] * 27) & 31;
+	KeywordSlot slot = keyword_slot[hash];
+	if (slot.len == len && memcmp(slot.word, word, len) == 0)
+		return slot.kind;
+	return IDENTITY;
+}
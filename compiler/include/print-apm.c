@@ -4,8 +4,8 @@
 
 #ifndef PRINT_APM_STATE
 #define PRINT_APM_STATE
-size_t newlines_left;
-size_t current_indent;
+thread_local size_t newlines_left;
+thread_local size_t current_indent;
 enum LineStatus
 {
     NONE,
@@ -99,7 +99,7 @@ enum LineStatus
 // FORWARD DECLARATIONS //
 
 void PRINT_VARIABLE(Program *apm, Variable *var, const char *source_text);
-void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text);
+void PRINT_EXPRESSION(Program *apm, ExpressionIndex index, const char *source_text);
 void PRINT_STATEMENT(Program *apm, Statement *stmt, const char *source_text);
 void PRINT_BLOCK(Program *apm, Block *block, const char *source_text);
 void PRINT_FUNCTION(Program *apm, Function *funct, const char *source_text);
@@ -117,8 +117,9 @@ void PRINT_VARIABLE(Program *apm, Variable *var, const char *source_text)
 
 // PRINT EXPRESSION //
 
-void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text)
+void PRINT_EXPRESSION(Program *apm, ExpressionIndex index, const char *source_text)
 {
+    Expression *expr = get_expression(apm, index);
     switch (expr->kind)
     {
     case INVALID_EXPRESSION:
@@ -126,7 +127,7 @@ void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text)
         break;
 
     case IDENTITY_LITERAL:
-        PRINT_SUBSTR(expr->identity);
+        PRINT_SUBSTR(*get_expression_span(apm, index));
         break;
 
     case NONE_LITERAL:
@@ -138,7 +139,7 @@ void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text)
         break;
 
     case INTEGER_LITERAL:
-        PRINT_INT(expr->integer_value);
+        PRINT("%lld", (long long)expr->integer_value);
         break;
 
     case FLOAT_LITERAL:
@@ -173,37 +174,36 @@ void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text)
         PRINT("p<%02d>", expr->parameter);
         break;
 
+    case PROPERTY_REFERENCE:
+        PRINT_SUBSTR(expr->property->identity);
+        break;
+
     case FUNCTION_CALL:
         PRINT("FUNCTION_CALL");
         INDENT();
         NEWLINE();
 
-        if (expr->arguments.count == 0)
+        if (expr->argument_count == 0)
             LAST_ON_LINE();
 
         PRINT("callee: ");
         PRINT_EXPRESSION(apm, expr->callee, source_text);
         NEWLINE();
 
-        if (expr->arguments.count > 0)
+        if (expr->argument_count > 0)
         {
             LAST_ON_LINE();
             PRINT("arguments:");
             NEWLINE();
             INDENT();
 
-            Argument *arg;
-            Iterator it = create_iterator(&expr->arguments);
-            size_t i = 0;
-            while (arg = advance_iterator_of(&it, Argument))
+            for (size_t i = 0; i < expr->argument_count; i++)
             {
-                if (i == expr->arguments.count - 1)
+                if (i == expr->argument_count - 1)
                     LAST_ON_LINE();
 
-                PRINT_EXPRESSION(apm, arg->expr, source_text);
+                PRINT_EXPRESSION(apm, get_argument(apm, index, i), source_text);
                 NEWLINE();
-
-                i++;
             }
 
             UNINDENT();
@@ -220,7 +220,7 @@ void PRINT_EXPRESSION(Program *apm, Expression *expr, const char *source_text)
 
         NEWLINE();
         PRINT("field: ")
-        PRINT_SUBSTR(expr->field);
+        PRINT_EXPRESSION(apm, expr->field, source_text);
 
         NEWLINE();
         LAST_ON_LINE();
@@ -439,7 +439,7 @@ void PRINT_STATEMENT(Program *apm, Statement *stmt, const char *source_text)
         PRINT_VARIABLE(apm, stmt->variable, source_text);
         NEWLINE();
 
-        if (stmt->type_expression == NULL && stmt->initial_value == NULL)
+        if (stmt->type_expression == NO_EXPRESSION && stmt->initial_value == NO_EXPRESSION)
             LAST_ON_LINE();
 
         PRINT("order: %d", stmt->variable->order);
@@ -447,7 +447,7 @@ void PRINT_STATEMENT(Program *apm, Statement *stmt, const char *source_text)
 
         if (stmt->type_expression)
         {
-            if (stmt->initial_value == NULL)
+            if (stmt->initial_value == NO_EXPRESSION)
                 LAST_ON_LINE();
 
             PRINT("type_expression: ");
@@ -570,7 +570,10 @@ void PRINT_FUNCTION(Program *apm, Function *funct, const char *source_text)
 
     LAST_ON_LINE();
     PRINT("body: ");
-    PRINT_BLOCK(apm, funct->body, source_text);
+    if (funct->body)
+        PRINT_BLOCK(apm, funct->body, source_text);
+    else
+        PRINT("(not parsed)");
 
     UNINDENT();
     NEWLINE();
@@ -1,4 +1,5 @@
 #include "interpret.h"
+#include "assemble.h"
 
 // INTERPRETER VALUES //
 
@@ -37,17 +38,16 @@ typedef struct
 
 // IO //
 
-char float_to_str_buffer[64];
-
 // FIXME: This implementation cannot handle particularly large floats
 //        e.g. 1000000000000000000000000000000.1
-void float_to_str(double x)
+// NOTE: The buffer must hold at least 64 characters
+void float_to_str(double x, char *buffer)
 {
     size_t c = 0;
 
     if (x < 0)
     {
-        float_to_str_buffer[c++] = '-';
+        buffer[c++] = '-';
         x = -x;
     }
 
@@ -56,29 +56,29 @@ void float_to_str(double x)
 
     int f = c;
     do
-        float_to_str_buffer[c++] = '0' + integer_portion % 10;
+        buffer[c++] = '0' + integer_portion % 10;
     while (integer_portion /= 10);
     int l = c - 1;
 
     while (l > f)
     {
-        char t = float_to_str_buffer[f];
-        float_to_str_buffer[f++] = float_to_str_buffer[l];
-        float_to_str_buffer[l--] = t;
+        char t = buffer[f];
+        buffer[f++] = buffer[l];
+        buffer[l--] = t;
     }
 
     if (rational_portion > 0.0001)
     {
-        float_to_str_buffer[c++] = '.';
+        buffer[c++] = '.';
         while (rational_portion > 0.0001)
         {
             int d = rational_portion * 10;
-            float_to_str_buffer[c++] = '0' + (d % 10);
+            buffer[c++] = '0' + (d % 10);
             rational_portion = rational_portion * 10 - d;
         }
     }
 
-    float_to_str_buffer[c] = '\0';
+    buffer[c] = '\0';
 }
 
 void output_to(RunOnString *output, const char *format, ...)
@@ -145,9 +145,12 @@ typedef struct
     Record *top;
 } Stack;
 
+// NOTE: Images with more units than this can not be run either
+#define MAX_UNIT_COUNT 64
+
 typedef struct
 {
-    Stack stack[64]; // TODO: Set this dynamically according to the number of Units
+    Stack stack[MAX_UNIT_COUNT]; // TODO: Set this dynamically according to the number of Units
     size_t count;
 } CallStacks;
 
@@ -174,6 +177,32 @@ Record *push_record(CallStacks *call_stacks, Unit *unit)
     return record;
 }
 
+// Add a call stack for each unit in the list of units, starting from `unit`
+void add_call_stacks(CallStacks *call_stacks, Unit *unit)
+{
+    while (unit)
+    {
+        size_t i = call_stacks->count++;
+        assert(call_stacks->count <= MAX_UNIT_COUNT);
+        call_stacks->stack[i].unit = unit;
+        call_stacks->stack[i].top = NULL;
+        unit = unit->next;
+    }
+}
+
+// The first time a stub is called, the function is assembled and given a call stack.
+// The call site is then patched to call the assembled unit directly.
+Unit *link_stub_call(CallStacks *call_stacks, Unit *unit, size_t payload, Unit *stub)
+{
+    bool first_call = stub->assembled == NULL;
+
+    Unit *callee = link_stub(stub, unit, payload);
+    if (first_call)
+        add_call_stacks(call_stacks, callee);
+
+    return callee;
+}
+
 void pop_record(CallStacks *call_stacks, Unit *unit, Record *record)
 {
     Stack *stack = get_call_stack(call_stacks, unit);
@@ -235,16 +264,14 @@ inline void set_reg(CallStacks *call_stacks, Unit *unit, Record *record, vm_reg
         var = as.data;                                              \
     }
 
-RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, Record *record, RunOnString *output_string)
-{
-    size_t program_counter = 0;
+RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, Record *record, RunOnString *output_string);
 
+// Interpret the instructions of a unit from `program_counter` up to `end`, using an existing record
+RhinoValue interpret_instructions(Memory *memory, CallStacks *call_stacks, Unit *unit, Record *record, RunOnString *output_string, size_t program_counter, size_t end)
+{
     RhinoValue stack_value[128];
     size_t stack_pointer = 0;
 
-    if (!record)
-        record = push_record(call_stacks, unit);
-
 #define GET(reg, up) get_reg(call_stacks, unit, record, reg, up)
 #define PTR(reg, up) point_to_reg(call_stacks, unit, record, reg, up)
 #define SET(reg, up, value) set_reg(call_stacks, unit, record, reg, up, value)
@@ -252,7 +279,7 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
     RhinoValue return_value = NONE_VALUE();
 
     // printf("%p\n", unit);
-    while (program_counter < unit->count)
+    while (program_counter < end)
     {
         // printf_instruction(unit, program_counter);
         Instruction ins = unit->instruction[program_counter++];
@@ -263,6 +290,8 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
         case OP_CALL:
         {
             FETCH_DATA(Unit *, callee);
+            if (callee->lazy_function)
+                callee = link_stub_call(call_stacks, unit, program_counter - (wordsizeof(Unit *)), callee);
 
             Record *callee_record = push_record(call_stacks, callee);
             for (size_t i = 0; i < callee->parameter_count; i++)
@@ -279,6 +308,8 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
         case OP_RUN:
         {
             FETCH_DATA(Unit *, callee);
+            if (callee->lazy_function)
+                callee = link_stub_call(call_stacks, unit, program_counter - (wordsizeof(Unit *)), callee);
 
             Record *callee_record = push_record(call_stacks, callee);
             for (size_t i = 0; i < callee->parameter_count; i++)
@@ -294,7 +325,7 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
         case OP_RTNV:
             return_value = GET(ins.a, ins.x);
         case OP_RTNN:
-            program_counter = unit->count;
+            program_counter = end;
             break;
 
         case OP_JUMP:
@@ -494,8 +525,7 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
                 sprintf(buffer, "%s", value.as_bool ? "true" : "false");
             else if (value.kind == RHINO_NUM)
             {
-                float_to_str(value.as_num);
-                sprintf(buffer, "%s", float_to_str_buffer);
+                float_to_str(value.as_num, buffer);
             }
             else
                 fatal_error("Could not cast %s value to string.", rhino_value_kind_string(value.kind));
@@ -516,27 +546,507 @@ RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, R
         }
     }
 
+    return return_value;
+}
+
+RhinoValue interpret_unit(Memory *memory, CallStacks *call_stacks, Unit *unit, Record *record, RunOnString *output_string)
+{
+    if (!record)
+        record = push_record(call_stacks, unit);
+
+    RhinoValue return_value = interpret_instructions(memory, call_stacks, unit, record, output_string, 0, unit->count);
+
     pop_record(call_stacks, unit, record);
     return return_value;
 }
 
+void init_call_stacks(CallStacks *call_stacks, Unit *init)
+{
+    call_stacks->count = 0;
+    add_call_stacks(call_stacks, init);
+}
+
 void interpret(ByteCode *byte_code, RunOnString *output_string)
 {
     Memory memory;
     memory.next = 0;
 
     CallStacks call_stacks;
-    call_stacks.count = 0;
+    init_call_stacks(&call_stacks, byte_code->init);
 
-    Unit *unit = byte_code->init;
-    while (unit)
+    interpret_unit(&memory, &call_stacks, byte_code->init, NULL, output_string);
+}
+
+// SNAPSHOTS //
+// A snapshot image contains the byte code of a program along with the state of the program
+// immediately before the init unit runs main, i.e. after all global variables have been
+// initialised. Running an image restores that state and then continues directly from main.
+//
+// Pointers to units and strings are stored as indices into the image's unit and string tables.
+// NOTE: Images store values in the native byte order, and so are not portable between platforms.
+
+#define IMAGE_MAGIC "RHINOIMG"
+#define IMAGE_MAGIC_LEN 8
+#define IMAGE_VERSION 1
+#define IMAGE_NO_UNIT UINT64_MAX
+
+typedef struct
+{
+    char **str;
+    size_t count;
+    size_t capacity;
+} ImageStrings;
+
+size_t get_image_string_index(ImageStrings *strings, char *str)
+{
+    for (size_t i = 0; i < strings->count; i++)
+        if (strings->str[i] == str)
+            return i;
+
+    if (strings->count == strings->capacity)
     {
-        size_t i = call_stacks.count++;
-        assert(call_stacks.count <= 64); // TODO: Set the size of the array dynamically according to the number of Units
-        call_stacks.stack[i].unit = unit;
-        call_stacks.stack[i].top = NULL;
-        unit = unit->next;
+        strings->capacity = strings->capacity == 0 ? 16 : strings->capacity * 2;
+        strings->str = (char **)realloc(strings->str, sizeof(char *) * strings->capacity);
     }
 
-    interpret_unit(&memory, &call_stacks, byte_code->init, NULL, output_string);
-}
\ No newline at end of file
+    strings->str[strings->count] = str;
+    return strings->count++;
+}
+
+uint64_t get_image_unit_index(Unit *first, Unit *unit)
+{
+    if (!unit)
+        return IMAGE_NO_UNIT;
+
+    uint64_t i = 0;
+    for (Unit *u = first; u; u = u->next, i++)
+        if (u == unit)
+            return i;
+
+    fatal_error("Unable to find Unit %p in byte code.", unit);
+    unreachable;
+}
+
+// Unit and string pointers are stored in the payload of CALL, RUN and LOAD_STR instructions
+typedef union
+{
+    void *ptr;
+    uintptr_t index;
+    uint32_t word[wordsizeof(void *)];
+} PointerPayload;
+
+bool has_pointer_payload(OpCode op)
+{
+    return op == OP_CALL || op == OP_RUN || op == OP_LOAD_STR;
+}
+
+PointerPayload get_pointer_payload(Instruction *payload)
+{
+    PointerPayload as;
+    for (size_t w = 0; w < wordsizeof(void *); w++)
+        as.word[w] = payload[w].word;
+    return as;
+}
+
+void set_pointer_payload(Instruction *payload, PointerPayload as)
+{
+    for (size_t w = 0; w < wordsizeof(void *); w++)
+        payload[w].word = as.word[w];
+}
+
+typedef struct
+{
+    FILE *handle;
+    bool valid; // Cleared by any write that fails, e.g. because the disk is full
+} ImageWriter;
+
+void write_bytes(ImageWriter *writer, const void *src, size_t len)
+{
+    if (writer->valid && fwrite(src, 1, len, writer->handle) != len)
+        writer->valid = false;
+}
+
+void write_u64(ImageWriter *writer, uint64_t value)
+{
+    write_bytes(writer, &value, sizeof(uint64_t));
+}
+
+void write_image_value(ImageWriter *writer, ImageStrings *strings, RhinoValue value)
+{
+    if (value.kind == RHINO_STR)
+        value.as_bits = get_image_string_index(strings, value.as_str);
+
+    write_bytes(writer, &value, sizeof(RhinoValue));
+}
+
+bool snapshot(ByteCode *byte_code, const char *path)
+{
+    // Run the init unit up until it would run main
+    Memory memory;
+    memory.next = 0;
+
+    CallStacks call_stacks;
+    init_call_stacks(&call_stacks, byte_code->init);
+
+    Unit *init = byte_code->init;
+    Record *record = push_record(&call_stacks, init);
+    memset(record->register_value, 0, sizeof(RhinoValue) * init->register_count);
+
+    RunOnString init_output;
+    init_run_on_string(&init_output, 1);
+    interpret_instructions(&memory, &call_stacks, init, record, &init_output, 0, byte_code->run_main);
+
+    // Write image
+    ImageWriter writer;
+    writer.handle = fopen(path, "wb");
+    writer.valid = true;
+    if (writer.handle == NULL)
+    {
+        fprintf(stderr, "Error writing file %s\n", path);
+        return false;
+    }
+
+    ImageStrings strings;
+    strings.str = NULL;
+    strings.count = 0;
+    strings.capacity = 0;
+
+    // Collect strings, so that the string table can be written before anything that refers to it
+    for (Unit *unit = init; unit; unit = unit->next)
+    {
+        for (size_t i = 0; i < unit->count; i += 1 + get_playload_size((OpCode)unit->instruction[i].op))
+        {
+            if (unit->instruction[i].op == OP_LOAD_STR)
+                get_image_string_index(&strings, (char *)get_pointer_payload(unit->instruction + i + 1).ptr);
+        }
+    }
+
+    for (size_t i = 0; i < init->register_count; i++)
+        if (record->register_value[i].kind == RHINO_STR)
+            get_image_string_index(&strings, record->register_value[i].as_str);
+
+    for (size_t i = 0; i < memory.next; i++)
+        if (memory.value[i].kind == RHINO_STR)
+            get_image_string_index(&strings, memory.value[i].as_str);
+
+    // Header
+    write_bytes(&writer, IMAGE_MAGIC, IMAGE_MAGIC_LEN);
+    write_u64(&writer, IMAGE_VERSION);
+    write_u64(&writer, byte_code->run_main);
+    write_u64(&writer, get_image_unit_index(init, byte_code->main));
+
+    // Strings
+    write_u64(&writer, strings.count);
+    for (size_t i = 0; i < strings.count; i++)
+    {
+        size_t len = strlen(strings.str[i]);
+        write_u64(&writer, len);
+        write_bytes(&writer, strings.str[i], len);
+    }
+
+    // Units
+    size_t unit_count = 0;
+    for (Unit *unit = init; unit; unit = unit->next)
+        unit_count++;
+
+    write_u64(&writer, unit_count);
+    for (Unit *unit = init; unit; unit = unit->next)
+    {
+        write_u64(&writer, unit->parameter_count);
+        write_u64(&writer, unit->register_count);
+        write_u64(&writer, get_image_unit_index(init, unit->nested_in));
+        write_u64(&writer, unit->count);
+
+        Instruction instruction[1024];
+        memcpy(instruction, unit->instruction, sizeof(Instruction) * unit->count);
+
+        for (size_t i = 0; i < unit->count; i += 1 + get_playload_size((OpCode)unit->instruction[i].op))
+        {
+            OpCode op = (OpCode)unit->instruction[i].op;
+            if (!has_pointer_payload(op))
+                continue;
+
+            PointerPayload as = get_pointer_payload(instruction + i + 1);
+            if (op == OP_LOAD_STR)
+                as.index = get_image_string_index(&strings, (char *)as.ptr);
+            else
+                as.index = get_image_unit_index(init, (Unit *)as.ptr);
+            set_pointer_payload(instruction + i + 1, as);
+        }
+
+        write_bytes(&writer, instruction, sizeof(Instruction) * unit->count);
+    }
+
+    // Global variables
+    write_u64(&writer, init->register_count);
+    for (size_t i = 0; i < init->register_count; i++)
+        write_image_value(&writer, &strings, record->register_value[i]);
+
+    // Memory
+    write_u64(&writer, memory.next);
+    for (size_t i = 0; i < memory.next; i++)
+        write_image_value(&writer, &strings, memory.value[i]);
+
+    // Output produced by the init unit, which is replayed when the image is run
+    write_u64(&writer, init_output.len);
+    write_bytes(&writer, init_output.str, init_output.len);
+
+    // Buffered writes may only fail once they are flushed
+    if (fclose(writer.handle) != 0)
+        writer.valid = false;
+    free(strings.str);
+
+    // Do not leave a truncated image behind
+    if (!writer.valid)
+    {
+        fprintf(stderr, "Error writing file %s\n", path);
+        remove(path);
+        return false;
+    }
+
+    return true;
+}
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    size_t pos;
+    bool valid;
+} ImageReader;
+
+void read_bytes(ImageReader *reader, void *dst, size_t len)
+{
+    if (!reader->valid || len > reader->size - reader->pos)
+    {
+        reader->valid = false;
+        memset(dst, 0, len);
+        return;
+    }
+
+    memcpy(dst, reader->data + reader->pos, len);
+    reader->pos += len;
+}
+
+uint64_t read_u64(ImageReader *reader)
+{
+    uint64_t value;
+    read_bytes(reader, &value, sizeof(uint64_t));
+    return value;
+}
+
+RhinoValue read_image_value(ImageReader *reader, char **strings, size_t string_count)
+{
+    RhinoValue value;
+    read_bytes(reader, &value, sizeof(RhinoValue));
+
+    if (value.kind == RHINO_STR)
+    {
+        if (value.as_bits < string_count)
+            value.as_str = strings[value.as_bits];
+        else
+            reader->valid = false;
+    }
+
+    return value;
+}
+
+bool is_image_file(const char *path)
+{
+    FILE *handle = fopen(path, "rb");
+    if (handle == NULL)
+        return false;
+
+    // Do not read from pipes, as that would consume the start of the source text
+    if (fseek(handle, 0, SEEK_SET) != 0)
+    {
+        fclose(handle);
+        return false;
+    }
+
+    char magic[IMAGE_MAGIC_LEN];
+    bool is_image = fread(magic, 1, IMAGE_MAGIC_LEN, handle) == IMAGE_MAGIC_LEN &&
+                    memcmp(magic, IMAGE_MAGIC, IMAGE_MAGIC_LEN) == 0;
+
+    fclose(handle);
+    return is_image;
+}
+
+bool run_image(const char *path, RunOnString *output_string)
+{
+    // Read file
+    FILE *handle = fopen(path, "rb");
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Error reading file %s\n", path);
+        return false;
+    }
+
+    fseek(handle, 0, SEEK_END);
+    long file_size = ftell(handle);
+    fseek(handle, 0, SEEK_SET);
+
+    ImageReader reader;
+    reader.data = (uint8_t *)malloc(file_size);
+    reader.size = fread(reader.data, 1, file_size, handle);
+    reader.pos = 0;
+    reader.valid = true;
+    fclose(handle);
+
+    // Header
+    char magic[IMAGE_MAGIC_LEN];
+    read_bytes(&reader, magic, IMAGE_MAGIC_LEN);
+    uint64_t version = read_u64(&reader);
+    if (!reader.valid || memcmp(magic, IMAGE_MAGIC, IMAGE_MAGIC_LEN) != 0 || version != IMAGE_VERSION)
+    {
+        fprintf(stderr, "%s is not a compatible Rhino image\n", path);
+        free(reader.data);
+        return false;
+    }
+
+    ByteCode byte_code;
+    init_byte_code(&byte_code);
+    byte_code.run_main = read_u64(&reader);
+    uint64_t main_index = read_u64(&reader);
+
+    // Strings
+    uint64_t string_count = read_u64(&reader);
+    if (string_count > reader.size)
+    {
+        reader.valid = false;
+        string_count = 0;
+    }
+
+    char **strings = (char **)malloc(sizeof(char *) * (string_count + 1));
+    for (size_t i = 0; reader.valid && i < string_count; i++)
+    {
+        uint64_t len = read_u64(&reader);
+        if (len > reader.size)
+        {
+            reader.valid = false;
+            string_count = i;
+            break;
+        }
+
+        strings[i] = (char *)malloc(len + 1);
+        read_bytes(&reader, strings[i], len);
+        strings[i][len] = '\0';
+    }
+
+    // Units
+    uint64_t unit_count = read_u64(&reader);
+    if (unit_count == 0 || unit_count > MAX_UNIT_COUNT)
+        reader.valid = false;
+
+    Unit *units[MAX_UNIT_COUNT];
+    uint64_t nested_in[MAX_UNIT_COUNT];
+    for (size_t u = 0; reader.valid && u < unit_count; u++)
+    {
+        Unit *unit = (Unit *)malloc(sizeof(Unit));
+        init_unit(unit);
+        units[u] = unit;
+        if (u > 0)
+            units[u - 1]->next = unit;
+
+        unit->parameter_count = read_u64(&reader);
+        unit->register_count = read_u64(&reader);
+        nested_in[u] = read_u64(&reader);
+        unit->count = read_u64(&reader);
+
+        if (unit->count > 1024 || unit->register_count > 256)
+        {
+            reader.valid = false;
+            unit_count = u + 1;
+            break;
+        }
+
+        read_bytes(&reader, unit->instruction, sizeof(Instruction) * unit->count);
+    }
+
+    // Relocate pointers
+    for (size_t u = 0; reader.valid && u < unit_count; u++)
+    {
+        Unit *unit = units[u];
+
+        if (nested_in[u] != IMAGE_NO_UNIT && nested_in[u] >= unit_count)
+            reader.valid = false;
+        else
+            unit->nested_in = nested_in[u] == IMAGE_NO_UNIT ? NULL : units[nested_in[u]];
+
+        for (size_t i = 0; i < unit->count; i += 1 + get_playload_size((OpCode)unit->instruction[i].op))
+        {
+            OpCode op = (OpCode)unit->instruction[i].op;
+            if (!has_pointer_payload(op))
+                continue;
+
+            if (i + wordsizeof(void *) >= unit->count)
+            {
+                reader.valid = false;
+                break;
+            }
+
+            PointerPayload as = get_pointer_payload(unit->instruction + i + 1);
+            if (op == OP_LOAD_STR && as.index < string_count)
+                as.ptr = strings[as.index];
+            else if (op != OP_LOAD_STR && as.index < unit_count)
+                as.ptr = units[as.index];
+            else
+                reader.valid = false;
+            set_pointer_payload(unit->instruction + i + 1, as);
+        }
+    }
+
+    if (!reader.valid || main_index >= unit_count || byte_code.run_main > units[0]->count)
+    {
+        fprintf(stderr, "%s is not a valid Rhino image\n", path);
+        free(reader.data);
+        return false;
+    }
+
+    byte_code.init = units[0];
+    byte_code.main = units[main_index];
+
+    // Restore program state
+    CallStacks call_stacks;
+    init_call_stacks(&call_stacks, byte_code.init);
+
+    Unit *init = byte_code.init;
+    Record *record = push_record(&call_stacks, init);
+
+    uint64_t register_count = read_u64(&reader);
+    if (register_count != init->register_count)
+        reader.valid = false;
+    for (size_t i = 0; reader.valid && i < register_count; i++)
+        record->register_value[i] = read_image_value(&reader, strings, string_count);
+
+    Memory memory;
+    memory.next = read_u64(&reader);
+    if (memory.next > 1024)
+        reader.valid = false;
+    for (size_t i = 0; reader.valid && i < memory.next; i++)
+        memory.value[i] = read_image_value(&reader, strings, string_count);
+
+    uint64_t output_len = read_u64(&reader);
+    if (output_len > reader.size - reader.pos)
+        reader.valid = false;
+
+    if (!reader.valid)
+    {
+        fprintf(stderr, "%s is not a valid Rhino image\n", path);
+        free(reader.data);
+        return false;
+    }
+
+    // Replay output of the init unit, then continue from main
+    if (output_string)
+        append_run_on_string_with_length(output_string, (char *)reader.data + reader.pos, output_len);
+    else
+        fwrite(reader.data + reader.pos, 1, output_len, stdout);
+
+    free(reader.data);
+
+    interpret_instructions(&memory, &call_stacks, init, record, output_string, byte_code.run_main, init->count);
+    pop_record(&call_stacks, init, record);
+
+    return true;
+}
@@ -6,4 +6,8 @@
 
 void interpret(ByteCode *byte_code, RunOnString *output_string);
 
+bool snapshot(ByteCode *byte_code, const char *path);
+bool is_image_file(const char *path);
+bool run_image(const char *path, RunOnString *output_string);
+
 #endif
\ No newline at end of file
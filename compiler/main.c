@@ -6,6 +6,8 @@
 #include "parse.h"
 #include "resolve.h"
 #include "check.h"
+#include "fold.h"
+#include "prune.h"
 #include "assemble.h"
 #include "interpret.h"
 
@@ -17,34 +19,17 @@
 
 // READ FILE //
 
-char *read_file(const char *path)
+bool read_source_file(Compiler *c, const char *path)
 {
-    FILE *handle = fopen(path, "rb");
-
-    if (handle == NULL)
+    c->source_path = path;
+    if (!load_source_file(&c->source_file, path))
     {
         fprintf(stderr, "Error reading file %s\n", path);
-        return NULL;
-    }
-
-    fseek(handle, 0, SEEK_END);
-    long file_size = ftell(handle);
-
-    char *file_text = (char *)malloc(file_size + 1);
-    if (file_text == NULL)
-    {
-        fclose(handle);
-        fprintf(stderr, "Unable to allocate memory to store source text\n");
-        return NULL;
+        return false;
     }
 
-    fseek(handle, 0, SEEK_SET);
-    fread(file_text, 1, file_size, handle);
-    file_text[file_size] = '\0';
-
-    fclose(handle);
-
-    return file_text;
+    c->source_text = c->source_file.text;
+    return true;
 }
 
 // MAIN //
@@ -53,8 +38,20 @@ bool flag_test_mode = false;
 bool flag_token_dump = false;
 bool flag_parse_dump = false;
 bool flag_resolve_dump = false;
+bool flag_prune_dump = false;
 bool flag_byte_code_dump = false;
 bool flag_memmap = false;
+bool flag_memory_stats = false;
+bool flag_snapshot = false;
+bool flag_lazy_assemble = false;
+bool flag_lazy_parse = false;
+bool flag_stream = false;
+bool flag_stream_thread = false;
+bool flag_parallel = false;
+bool flag_split = false;
+
+// With -split, even small sources are tokenised in chunks, so that tests cover parallel tokenisation
+#define SPLIT_CHUNK_COUNT 4
 
 bool process_arguments(int argc, char *argv[])
 {
@@ -71,10 +68,28 @@ bool process_arguments(int argc, char *argv[])
             flag_parse_dump = true;
         else if ((strcmp(argv[i], "-r") == 0) || strcmp(argv[i], "-resolve") == 0)
             flag_resolve_dump = true;
+        else if (strcmp(argv[i], "-pruned") == 0)
+            flag_prune_dump = true;
         else if ((strcmp(argv[i], "-b") == 0) || strcmp(argv[i], "-byte") == 0)
             flag_byte_code_dump = true;
         else if ((strcmp(argv[i], "-memmap") == 0))
             flag_memmap = true;
+        else if ((strcmp(argv[i], "-memstats") == 0))
+            flag_memory_stats = true;
+        else if ((strcmp(argv[i], "-snapshot") == 0))
+            flag_snapshot = true;
+        else if ((strcmp(argv[i], "-lazy") == 0))
+            flag_lazy_assemble = true;
+        else if ((strcmp(argv[i], "-lazy-parse") == 0))
+            flag_lazy_parse = true;
+        else if ((strcmp(argv[i], "-stream") == 0))
+            flag_stream = true;
+        else if ((strcmp(argv[i], "-stream-thread") == 0))
+            flag_stream = flag_stream_thread = true;
+        else if ((strcmp(argv[i], "-parallel") == 0))
+            flag_parallel = true;
+        else if ((strcmp(argv[i], "-split") == 0))
+            flag_split = true;
         else
             return false;
     }
@@ -88,25 +103,55 @@ int main(int argc, char *argv[])
     bool valid_arguments = process_arguments(argc, argv);
     if (!valid_arguments)
     {
-        fprintf(stderr, "Usage: %s <file_path> [-test] [-token] [-parse] [-resolve] [-nice]\n", argv[0]);
+        fprintf(stderr, "Usage: %s <file_path | -> [-test] [-t | -token] [-p | -parse] [-r | -resolve] [-pruned] [-b | -byte] [-memmap] [-memstats] [-snapshot] [-lazy] [-lazy-parse] [-stream] [-stream-thread] [-parallel] [-split]\n", argv[0]);
+        fprintf(stderr, "NOTE: With -lazy-parse, errors are only reported in functions that are referenced\n");
         return EXIT_FAILURE;
     }
 
+    // Snapshot images have already been compiled, and start directly from main
+    if (is_image_file(argv[1]))
+    {
+        if (flag_test_mode)
+        {
+            RunOnString output_buffer;
+            init_run_on_string(&output_buffer, 1);
+            if (!run_image(argv[1], &output_buffer))
+                return EXIT_FAILURE;
+
+            printf("SUCCESS\n");
+            printf(output_buffer.str);
+            return EXIT_SUCCESS;
+        }
+
+        HEADING("Interpret image");
+        if (!run_image(argv[1], NULL))
+            return EXIT_FAILURE;
+
+        HEADING("Complete");
+        return EXIT_SUCCESS;
+    }
+
     // Test mode
     if (flag_test_mode)
     {
         Compiler compiler;
         init_compiler(&compiler);
+        compiler.parse_lazily = flag_lazy_parse && !flag_stream; // Lazy parsing needs to revisit tokens after parsing
+        compiler.parallel_functions = flag_parallel && !compiler.parse_lazily; // Lazy parsing moves the token cursor during resolution
+    compiler.tokenise_chunk_count = flag_split ? SPLIT_CHUNK_COUNT : 0;
 
-        compiler.source_path = argv[1];
-        compiler.source_text = read_file(compiler.source_path);
-        if (compiler.source_text == NULL)
+        if (!read_source_file(&compiler, argv[1]))
             return EXIT_FAILURE;
 
-        tokenise(&compiler);
+        if (flag_stream)
+            start_token_stream(&compiler, flag_stream_thread);
+        else
+            tokenise(&compiler);
 
         Program apm;
         parse(&compiler, &apm);
+        if (flag_stream)
+            end_token_stream(&compiler);
         resolve(&compiler, &apm);
         check(&compiler, &apm);
 
@@ -126,13 +171,34 @@ int main(int argc, char *argv[])
             return EXIT_FAILURE;
         }
 
+        fold(&compiler, &apm);
+        prune(&compiler, &apm);
+
         ByteCode byte_code;
         init_byte_code(&byte_code);
-        assemble(&compiler, &apm, &byte_code);
+        assemble(&compiler, &apm, &byte_code, flag_lazy_assemble && !flag_snapshot);
+
+        // Tests compare the standard output, so memory stats are written to the standard error
+        if (flag_memory_stats)
+            fprintf_compiler_memory(stderr, &compiler);
 
         RunOnString output_buffer;
         init_run_on_string(&output_buffer, 1);
-        interpret(&byte_code, &output_buffer);
+
+        // Tests of snapshots run the program from its image, which is then deleted
+        if (flag_snapshot)
+        {
+            char *image_path = (char *)malloc(strlen(compiler.source_path) + 7);
+            sprintf(image_path, "%s.rhimg", compiler.source_path);
+            bool ran_image = snapshot(&byte_code, image_path) && run_image(image_path, &output_buffer);
+            remove(image_path);
+            if (!ran_image)
+                return EXIT_FAILURE;
+        }
+        else
+        {
+            interpret(&byte_code, &output_buffer);
+        }
 
         printf("SUCCESS\n");
         printf(output_buffer.str);
@@ -143,30 +209,38 @@ int main(int argc, char *argv[])
     // Compile
     Compiler compiler;
     init_compiler(&compiler);
+    compiler.parse_lazily = flag_lazy_parse && !flag_stream; // Lazy parsing needs to revisit tokens after parsing
+    compiler.parallel_functions = flag_parallel && !compiler.parse_lazily; // Lazy parsing moves the token cursor during resolution
+    compiler.tokenise_chunk_count = flag_split ? SPLIT_CHUNK_COUNT : 0;
 
     HEADING("Reading source file");
-    compiler.source_path = argv[1];
-    compiler.source_text = read_file(compiler.source_path);
-    if (compiler.source_text == NULL)
+    if (!read_source_file(&compiler, argv[1]))
         return EXIT_FAILURE;
 
     HEADING("Tokenise");
-    tokenise(&compiler);
-    if (flag_token_dump)
+    if (flag_stream)
+        start_token_stream(&compiler, flag_stream_thread);
+    else
+        tokenise(&compiler);
+
+    if (flag_token_dump && !flag_stream)
     {
-        for (size_t i = 0; i < compiler.token_count; i++)
+        TokenArray *tokens = &compiler.tokens;
+        for (size_t i = 0; i < tokens->count; i++)
         {
-            Token t = compiler.tokens[i];
             printf("%03d\t", i);
-            printf("%-*s\t", 13, token_kind_string(t.kind));
-            printf("%3d %2d\t", t.str.pos, t.str.len);
-            printf("%.*s\n", t.str.len, compiler.source_text + t.str.pos);
+            printf("%-*s\t", 13, token_kind_string((TokenKind)tokens->kind[i]));
+            printf("%3d %2d\t", tokens->pos[i], tokens->len[i]);
+            printf("%.*s\n", tokens->len[i], compiler.source_text + tokens->pos[i]);
         }
     }
 
     HEADING("Parse");
     Program apm;
     parse(&compiler, &apm);
+    if (flag_stream)
+        end_token_stream(&compiler);
+
     if (flag_parse_dump)
         print_parsed_apm(&apm, compiler.source_text);
 
@@ -181,7 +255,7 @@ int main(int argc, char *argv[])
     if (flag_memmap)
     {
         HEADING("Memmap");
-        memmap(&apm, compiler.apm_allocator);
+        memmap(&apm, &compiler);
         HEADING("Complete");
         return EXIT_SUCCESS;
     }
@@ -196,13 +270,41 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    HEADING("Fold");
+    fold(&compiler, &apm);
+
+    HEADING("Prune");
+    prune(&compiler, &apm);
+    if (flag_prune_dump)
+        printf_pruned_apm(&apm, compiler.source_text);
+
     HEADING("Assemble");
     ByteCode byte_code;
     init_byte_code(&byte_code);
-    assemble(&compiler, &apm, &byte_code);
+    // Snapshots contain all of the byte code, and so are always assembled eagerly
+    assemble(&compiler, &apm, &byte_code, flag_lazy_assemble && !flag_snapshot);
     if (flag_byte_code_dump)
         printf_byte_code(&byte_code);
 
+    if (flag_memory_stats)
+    {
+        HEADING("Memory");
+        fprintf_compiler_memory(stdout, &compiler);
+    }
+
+    if (flag_snapshot)
+    {
+        HEADING("Snapshot");
+        char *image_path = (char *)malloc(strlen(compiler.source_path) + 7);
+        sprintf(image_path, "%s.rhimg", compiler.source_path);
+        if (!snapshot(&byte_code, image_path))
+            return EXIT_FAILURE;
+        printf("Created image %s\n", image_path);
+
+        HEADING("Complete");
+        return EXIT_SUCCESS;
+    }
+
     HEADING("Interpret");
     interpret(&byte_code, NULL);
 
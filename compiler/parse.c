@@ -8,6 +8,8 @@ bool peek_next(Compiler *c, TokenKind token_kind);
 void advance(Compiler *c);
 void eat(Compiler *c, TokenKind token_kind);
 substr token_string(Compiler *c);
+TokenValue token_value(Compiler *c);
+Atom token_atom(Compiler *c);
 
 // Error and recovery
 void raise_parse_error(Compiler *c, CompilationErrorCode code);
@@ -22,14 +24,16 @@ bool peek_statement(Compiler *c);
 void parse(Compiler *compiler, Program *apm);
 void parse_program(Compiler *c, Program *apm);
 void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements);
+bool skip_curly_block(Compiler *c);
 void parse_enum_type(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements);
 void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements);
 void parse_variable_declaration(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements, Statement *declaration, bool declare_symbol_in_parent);
 
 void parse_program_block(Compiler *c, Program *apm);
+bool parse_program_block_in_parallel(Compiler *c, Program *apm, Block *program_block, Allocator *statements);
 Block *parse_block(Compiler *c, Program *apm, Block *parent);
 void parse_statement(Compiler *c, Program *apm, Allocator *allocator, Block *block);
-Expression *parse_expression(Compiler *c, Program *apm);
+ExpressionIndex parse_expression(Compiler *c, Program *apm);
 
 // MACROS //
 
@@ -38,22 +42,60 @@ Expression *parse_expression(Compiler *c, Program *apm);
 #define ADVANCE() advance(c)
 #define EAT(token_kind) eat(c, token_kind)
 #define TOKEN_STRING() token_string(c)
+#define TOKEN_VALUE() token_value(c)
+#define TOKEN_ATOM() token_atom(c)
 
 #define START_SPAN(node_ptr) node_ptr->span.pos = token_string(c).pos;
 #define END_SPAN(node_ptr) node_ptr->span.len = token_string(c).pos - node_ptr->span.pos;
 
+// EXPRESSIONS //
+
+// Returns the first of `count` consecutive new expressions, from the chunk of the expression table claimed by this compiler
+ExpressionIndex add_expressions(Compiler *c, Program *apm, size_t count)
+{
+    assert(count < EXPRESSION_CHUNK_SIZE); // FIXME: Handle calls with this many arguments properly
+    if (c->expression_chunk_end - c->next_expression < count)
+    {
+        c->next_expression = claim_expression_chunk(apm);
+        c->expression_chunk_end = (c->next_expression | (EXPRESSION_CHUNK_SIZE - 1)) + 1;
+    }
+
+    ExpressionIndex first = c->next_expression;
+    c->next_expression += (uint32_t)count;
+
+    for (ExpressionIndex i = first; i < c->next_expression; i++)
+    {
+        Expression *expr = get_expression(apm, i);
+        expr->kind = INVALID_EXPRESSION;
+        expr->resolved_type = INVALID_TYPE;
+    }
+    return first;
+}
+
+ExpressionIndex add_expression(Compiler *c, Program *apm)
+{
+    return add_expressions(c, apm, 1);
+}
+
 // TOKEN CONSUMPTION //
 
+TokenKind token_kind_at(Compiler *c, size_t i)
+{
+    if (c->token_stream)
+        require_token(c, i);
+    return (TokenKind)c->tokens.kind[TOKEN_SLOT(&c->tokens, i)];
+}
+
 bool peek(Compiler *c, TokenKind token_kind)
 {
-    return c->tokens[c->next_token].kind == token_kind;
+    return token_kind_at(c, c->next_token) == token_kind;
 }
 
 bool peek_next(Compiler *c, TokenKind token_kind)
 {
     if (peek(c, END_OF_FILE))
         return token_kind == END_OF_FILE;
-    return c->tokens[c->next_token + 1].kind == token_kind;
+    return token_kind_at(c, c->next_token + 1) == token_kind;
 }
 
 void advance(Compiler *c)
@@ -77,7 +119,21 @@ void eat(Compiler *c, TokenKind token_kind)
 
 substr token_string(Compiler *c)
 {
-    return c->tokens[c->next_token].str;
+    if (c->token_stream)
+        require_token(c, c->next_token);
+    return get_token_str(&c->tokens, c->next_token);
+}
+
+TokenValue token_value(Compiler *c)
+{
+    if (c->token_stream)
+        require_token(c, c->next_token);
+    return c->tokens.value[TOKEN_SLOT(&c->tokens, c->next_token)];
+}
+
+Atom token_atom(Compiler *c)
+{
+    return token_value(c).atom;
 }
 
 // ERROR AND RECOVERY //
@@ -86,7 +142,7 @@ void raise_parse_error(Compiler *c, CompilationErrorCode code)
 {
     if (c->parse_status == OKAY)
     {
-        raise_compilation_error(c, code, c->tokens[c->next_token].str);
+        raise_compilation_error(c, code, token_string(c));
     }
 
     c->parse_status = PANIC;
@@ -178,21 +234,18 @@ bool peek_statement(Compiler *c)
 
 void parse(Compiler *compiler, Program *apm)
 {
-    init_allocator(&compiler->apm_allocator);
     compiler->next_token = 0;
+    compiler->next_expression = 0;
+    compiler->expression_chunk_end = 0;
     compiler->parse_status = OKAY;
     parse_program(compiler, apm);
 }
 
 void parse_program(Compiler *c, Program *apm)
 {
-    apm->none_type.name = "none";
-    apm->bool_type.name = "bool";
-    apm->int_type.name = "int";
-    apm->num_type.name = "num";
-    apm->str_type.name = "str";
+    init_program(apm, &c->apm_allocator, &c->expression_arena);
 
-    apm->global_symbol_table = allocate_symbol_table(&c->apm_allocator, NULL);
+    apm->global_symbol_table = allocate_symbol_table(&c->symbol_arena, NULL);
     parse_program_block(c, apm);
 }
 
@@ -200,8 +253,11 @@ void parse_program(Compiler *c, Program *apm)
 void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements)
 {
     Function *funct = allocate(&c->apm_allocator, Function);
+    funct->body = NULL;
+    funct->has_lazy_body = false;
     funct->has_return_type_expression = false;
-    funct->return_type.tag = RHINO_UNINITIALISED_TYPE_TAG;
+    funct->return_type = UNINITIALISED_TYPE;
+    funct->is_reachable = false;
     START_SPAN(funct);
 
     Statement *declaration = allocate(parent_statements, Statement);
@@ -211,6 +267,8 @@ void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_
     EAT(KEYWORD_FN);
 
     funct->identity = TOKEN_STRING();
+
+    funct->identity_atom = TOKEN_ATOM();
     EAT(IDENTITY);
 
     Allocator param_allocator;
@@ -223,7 +281,9 @@ void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_
         START_SPAN(parameter);
 
         parameter->type_expression = parse_expression(c, apm);
+        parameter->type = INVALID_TYPE;
         parameter->identity = TOKEN_STRING();
+        parameter->identity_atom = TOKEN_ATOM();
         EAT(IDENTITY);
 
         END_SPAN(parameter);
@@ -234,7 +294,7 @@ void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_
     }
     EAT(PAREN_R);
 
-    funct->parameters = create_parameter_list(&param_allocator);
+    funct->parameters = create_parameter_list(&c->list_arena, &param_allocator);
 
     if (peek_expression(c))
     {
@@ -244,19 +304,113 @@ void parse_function(Compiler *c, Program *apm, Block *parent, Allocator *parent_
 
     // Adding the symbol here allows the function body to recursively refer to the function,
     // while preventing the function parameters or return type attempting to refer to it.
-    declare_symbol(&c->apm_allocator, parent->symbol_table, FUNCTION_SYMBOL, funct, funct->identity);
+    declare_symbol(&c->symbol_arena, parent->symbol_table, FUNCTION_SYMBOL, funct, funct->identity_atom);
 
     attempt_to_advance_to_next_code_block(c);
-    funct->body = parse_block(c, apm, parent);
+
+    // Skip the bodies of global functions when parsing lazily, they will be parsed when referenced
+    size_t body_token = c->next_token;
+    if (c->parse_lazily && parent->declaration_block && PEEK(CURLY_L) && skip_curly_block(c))
+    {
+        funct->has_lazy_body = true;
+        funct->body_token = body_token;
+    }
+    else
+    {
+        funct->body = parse_block(c, apm, parent);
+    }
 
     END_SPAN(funct);
     declaration->span = funct->span;
 }
 
+// Advance past a `{}` block by matching curly brackets, without parsing it
+// Returns false and leaves the parser where it was if the block is never closed
+bool skip_curly_block(Compiler *c)
+{
+    size_t start = c->next_token;
+    size_t depth = 0;
+
+    while (!PEEK(END_OF_FILE))
+    {
+        if (PEEK(CURLY_L))
+        {
+            depth++;
+        }
+        else if (PEEK(CURLY_R))
+        {
+            depth--;
+            if (depth == 0)
+            {
+                ADVANCE();
+                return true;
+            }
+        }
+
+        ADVANCE();
+    }
+
+    c->next_token = start;
+    return false;
+}
+
+// NOTE: Can return with status OKAY or RECOVERED
+void parse_lazy_function_body(Compiler *c, Program *apm, Function *funct)
+{
+    assert(funct->has_lazy_body && !funct->body);
+
+    size_t next_token = c->next_token;
+    c->next_token = funct->body_token;
+    c->parse_status = OKAY;
+
+    funct->body = parse_block(c, apm, apm->program_block);
+
+    c->next_token = next_token;
+}
+
+typedef struct
+{
+    RhinoType *type;
+    RhinoTypeTag tag;
+    void *ptr;
+} DeclaredType;
+
+// The noneable variant is interned too, so resolving never adds types to the table
+RhinoType intern_declared_type_now(Program *apm, RhinoTypeTag tag, void *ptr)
+{
+    RhinoType ty = intern_type(apm, tag, false, ptr);
+    intern_type(apm, tag, true, ptr);
+    return ty;
+}
+
+// Type IDs are given out in source order, so while declarations are parsed in parallel the types are
+// only recorded, and interned by intern_declared_types once every declaration has been parsed
+void intern_declared_type(Compiler *c, Program *apm, RhinoType *type, RhinoTypeTag tag, void *ptr)
+{
+    if (!c->declared_types)
+    {
+        *type = intern_declared_type_now(apm, tag, ptr);
+        return;
+    }
+
+    *type = INVALID_TYPE;
+    *allocate(c->declared_types, DeclaredType) = (DeclaredType){.type = type, .tag = tag, .ptr = ptr};
+}
+
+void intern_declared_types(Program *apm, Allocator *declared_types)
+{
+    DeclaredType *declared;
+    Iterator it = create_iterator(declared_types->first);
+    while (declared = advance_iterator_of(&it, DeclaredType))
+        *declared->type = intern_declared_type_now(apm, declared->tag, declared->ptr);
+}
+
 // TODO: Ensure this can only return with status OKAY or RECOVERED
 void parse_enum_type(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements)
 {
     EnumType *enum_type = allocate(&c->apm_allocator, EnumType);
+    intern_declared_type(c, apm, &enum_type->type, RHINO_ENUM_TYPE, enum_type);
+    enum_type->is_reachable = false;
     START_SPAN(enum_type);
 
     Statement *declaration = allocate(parent_statements, Statement);
@@ -266,6 +420,8 @@ void parse_enum_type(Compiler *c, Program *apm, Block *parent, Allocator *parent
     EAT(KEYWORD_ENUM);
 
     enum_type->identity = TOKEN_STRING();
+
+    enum_type->identity_atom = TOKEN_ATOM();
     EAT(IDENTITY);
 
     Allocator value_allocator;
@@ -279,6 +435,8 @@ void parse_enum_type(Compiler *c, Program *apm, Block *parent, Allocator *parent
         START_SPAN(enum_value);
 
         enum_value->identity = TOKEN_STRING();
+
+        enum_value->identity_atom = TOKEN_ATOM();
         EAT(IDENTITY);
 
         END_SPAN(enum_value);
@@ -289,24 +447,26 @@ void parse_enum_type(Compiler *c, Program *apm, Block *parent, Allocator *parent
     }
     EAT(CURLY_R);
 
-    enum_type->values = create_enum_value_list(&value_allocator);
+    enum_type->values = create_enum_value_list(&c->list_arena, &value_allocator);
 
     END_SPAN(enum_type);
     declaration->span = enum_type->span;
 
-    declare_symbol(&c->apm_allocator, parent->symbol_table, ENUM_TYPE_SYMBOL, enum_type, enum_type->identity);
+    declare_symbol(&c->symbol_arena, parent->symbol_table, ENUM_TYPE_SYMBOL, enum_type, enum_type->identity_atom);
 }
 
 // TODO: Ensure this can only return with status OKAY or RECOVERED
 void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements)
 {
-    Block *body = allocate(&c->apm_allocator, Block);
+    Block *body = allocate(&c->block_arena, Block);
     body->declaration_block = true;
     body->singleton_block = false;
-    body->symbol_table = allocate_symbol_table(&c->apm_allocator, parent->symbol_table);
+    body->symbol_table = allocate_symbol_table(&c->symbol_arena, parent->symbol_table);
 
     StructType *struct_type = allocate(&c->apm_allocator, StructType);
     struct_type->body = body;
+    intern_declared_type(c, apm, &struct_type->type, RHINO_STRUCT_TYPE, struct_type);
+    struct_type->is_reachable = false;
     START_SPAN(struct_type);
 
     Statement *declaration = allocate(parent_statements, Statement);
@@ -316,11 +476,13 @@ void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *pare
     EAT(KEYWORD_STRUCT);
 
     struct_type->identity = TOKEN_STRING();
+
+    struct_type->identity_atom = TOKEN_ATOM();
     EAT(IDENTITY);
 
     // Declaring the symbol here allows the struct to recursively refer to itself.
     // This is illegal for structs, but not for objects, and so for structs is an error.
-    declare_symbol(&c->apm_allocator, parent->symbol_table, STRUCT_TYPE_SYMBOL, struct_type, struct_type->identity);
+    declare_symbol(&c->symbol_arena, parent->symbol_table, STRUCT_TYPE_SYMBOL, struct_type, struct_type->identity_atom);
 
     Allocator statement_allocator;
     init_allocator(&statement_allocator);
@@ -337,7 +499,9 @@ void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *pare
             START_SPAN(property);
 
             property->type_expression = parse_expression(c, apm);
+            property->type = INVALID_TYPE;
             property->identity = TOKEN_STRING();
+            property->identity_atom = TOKEN_ATOM();
             EAT(IDENTITY);
             EAT(SEMI_COLON);
 
@@ -361,8 +525,8 @@ void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *pare
     }
     EAT(CURLY_R);
 
-    body->statements = create_statement_list(&statement_allocator);
-    struct_type->properties = create_property_list(&property_allocator);
+    body->statements = create_statement_list(&c->list_arena, &statement_allocator);
+    struct_type->properties = create_property_list(&c->list_arena, &property_allocator);
 
     END_SPAN(struct_type);
     declaration->span = struct_type->span;
@@ -371,7 +535,7 @@ void parse_struct_type(Compiler *c, Program *apm, Block *parent, Allocator *pare
 void parse_variable_declaration(Compiler *c, Program *apm, Block *parent, Allocator *parent_statements, Statement *declaration, bool declare_symbol_in_parent)
 {
     Variable *var = allocate(&c->apm_allocator, Variable);
-    var->type.tag = RHINO_UNINITIALISED_TYPE_TAG;
+    var->type = UNINITIALISED_TYPE;
 
     if (declaration == NULL)
     {
@@ -381,8 +545,8 @@ void parse_variable_declaration(Compiler *c, Program *apm, Block *parent, Alloca
 
     declaration->kind = VARIABLE_DECLARATION;
     declaration->variable = var;
-    declaration->type_expression = NULL;
-    declaration->initial_value = NULL;
+    declaration->type_expression = NO_EXPRESSION;
+    declaration->initial_value = NO_EXPRESSION;
     declaration->has_valid_identity = false;
 
     if (PEEK(KEYWORD_DEF))
@@ -411,6 +575,7 @@ void parse_variable_declaration(Compiler *c, Program *apm, Block *parent, Alloca
 parse_identity:
     declaration->has_valid_identity = true;
     var->identity = TOKEN_STRING();
+    var->identity_atom = TOKEN_ATOM();
     EAT(IDENTITY);
 
 parse_initial_value:
@@ -421,7 +586,7 @@ parse_initial_value:
     }
 
     if (declare_symbol_in_parent && declaration->has_valid_identity)
-        declare_symbol(&c->apm_allocator, parent->symbol_table, VARIABLE_SYMBOL, var, var->identity);
+        declare_symbol(&c->symbol_arena, parent->symbol_table, VARIABLE_SYMBOL, var, var->identity_atom);
 
     if (c->parse_status == PANIC)
         return;
@@ -559,14 +724,15 @@ void parse_statement(Compiler *c, Program *apm, Allocator *allocator, Block *blo
         stmt->iterator = iterator;
 
         iterator->identity = TOKEN_STRING();
-        iterator->type.tag = RHINO_UNINITIALISED_TYPE_TAG;
+
+        iterator->identity_atom = TOKEN_ATOM();
+        iterator->type = UNINITIALISED_TYPE;
         EAT(IDENTITY);
 
         EAT(KEYWORD_IN);
 
         // Iterable
-        Expression *iterable = parse_expression(c, apm);
-        stmt->iterable = iterable;
+        stmt->iterable = parse_expression(c, apm);
 
         // Body
         attempt_to_advance_to_next_code_block(c);
@@ -614,7 +780,7 @@ void parse_statement(Compiler *c, Program *apm, Allocator *allocator, Block *blo
     if (PEEK(KEYWORD_RETURN))
     {
         stmt->kind = RETURN_STATEMENT;
-        stmt->expression = NULL;
+        stmt->expression = NO_EXPRESSION;
 
         EAT(KEYWORD_RETURN);
 
@@ -633,7 +799,7 @@ void parse_statement(Compiler *c, Program *apm, Allocator *allocator, Block *blo
     else if (peek_expression(c))
     {
         size_t start_of_statement = c->next_token;
-        Expression *expr = parse_expression(c, apm);
+        ExpressionIndex expr = parse_expression(c, apm);
 
         if (c->parse_status == PANIC)
             goto recover;
@@ -728,18 +894,28 @@ recover:
 
 void parse_program_block(Compiler *c, Program *apm)
 {
-    Block *program_block = allocate(&c->apm_allocator, Block);
+    Block *program_block = allocate(&c->block_arena, Block);
     program_block->declaration_block = true;
     program_block->singleton_block = false;
-    program_block->symbol_table = allocate_symbol_table(&c->apm_allocator, apm->global_symbol_table);
+    program_block->symbol_table = allocate_symbol_table(&c->symbol_arena, apm->global_symbol_table);
 
     apm->program_block = program_block;
 
     Allocator statements_allocator;
     init_allocator(&statements_allocator);
 
+    if (c->parallel_functions && !c->token_stream && parse_program_block_in_parallel(c, apm, program_block, &statements_allocator))
+    {
+        program_block->statements = create_statement_list(&c->list_arena, &statements_allocator);
+        return;
+    }
+
     while (true)
     {
+        // When streaming, tokens from previous declarations will not be revisited
+        if (c->token_stream)
+            release_tokens_before(c, c->next_token);
+
         if (PEEK(END_OF_FILE))
             break;
 
@@ -788,13 +964,189 @@ void parse_program_block(Compiler *c, Program *apm)
         }
     }
 
-    program_block->statements = create_statement_list(&statements_allocator);
+    program_block->statements = create_statement_list(&c->list_arena, &statements_allocator);
+}
+
+// PARALLEL PARSING //
+
+typedef struct
+{
+    size_t start;
+    size_t end;
+    Allocator statements;
+    Allocator declared_types;
+    SymbolTable *symbol_table;
+    bool parsed_cleanly;
+} DeclarationSpan;
+
+typedef struct
+{
+    Program *apm;
+    Block *program_block;
+    DeclarationSpan *spans;
+    size_t span_count;
+} DeclarationSpans;
+
+// Find where each global declaration starts and ends by matching curly brackets, without parsing
+// Returns 0 if the program has a shape the scan does not understand, such as a `:` function body
+size_t find_declaration_spans(Compiler *c, DeclarationSpan **spans)
+{
+    size_t count = 0;
+    size_t capacity = 64;
+    *spans = (DeclarationSpan *)malloc(sizeof(DeclarationSpan) * capacity);
+
+    size_t i = 0;
+    while (token_kind_at(c, i) != END_OF_FILE)
+    {
+        TokenKind first = token_kind_at(c, i);
+        bool has_body = first == KEYWORD_FN || first == KEYWORD_STRUCT || first == KEYWORD_ENUM;
+        size_t start = i;
+
+        // Find the end of the declaration, which is either its `{}` body or a semicolon
+        size_t depth = 0;
+        while (true)
+        {
+            TokenKind kind = token_kind_at(c, i);
+            if (kind == END_OF_FILE || (kind == COLON && depth == 0) || (kind == CURLY_R && depth == 0))
+                goto unknown_shape;
+
+            i++;
+            if (kind == CURLY_L)
+            {
+                if (!has_body)
+                    goto unknown_shape;
+                depth++;
+            }
+            else if (kind == CURLY_R && --depth == 0)
+                break;
+            else if (kind == SEMI_COLON && depth == 0)
+            {
+                if (has_body)
+                    goto unknown_shape;
+                break;
+            }
+        }
+
+        if (count == capacity)
+        {
+            capacity *= 2;
+            *spans = (DeclarationSpan *)realloc(*spans, sizeof(DeclarationSpan) * capacity);
+        }
+        (*spans)[count++] = (DeclarationSpan){.start = start, .end = i};
+    }
+    return count;
+
+unknown_shape:
+    free(*spans);
+    *spans = NULL;
+    return 0;
+}
+
+void parse_declaration_span(Compiler *c, void *context, size_t i)
+{
+    DeclarationSpans *jobs = (DeclarationSpans *)context;
+    DeclarationSpan *span = &jobs->spans[i];
+
+    // Symbols are declared in a private table, and moved into the program block's table afterwards
+    Block block;
+    block.declaration_block = true;
+    block.singleton_block = false;
+    block.symbol_table = allocate_symbol_table(&c->symbol_arena, jobs->program_block->symbol_table->next);
+    span->symbol_table = block.symbol_table;
+    init_allocator(&span->statements);
+    init_allocator(&span->declared_types);
+    c->declared_types = &span->declared_types;
+
+    size_t error_count = c->error_count;
+    c->next_token = span->start;
+    c->parse_status = OKAY;
+
+    if (PEEK(KEYWORD_FN))
+        parse_function(c, jobs->apm, &block, &span->statements);
+    else if (PEEK(KEYWORD_ENUM))
+        parse_enum_type(c, jobs->apm, &block, &span->statements);
+    else if (PEEK(KEYWORD_STRUCT))
+        parse_struct_type(c, jobs->apm, &block, &span->statements);
+    else if (PEEK(KEYWORD_DEF) || peek_expression(c))
+        parse_variable_declaration(c, jobs->apm, &block, &span->statements, NULL, true);
+    else
+        raise_parse_error(c, UNEXPECTED_TOKEN_IN_PROGRAM);
+
+    span->parsed_cleanly = c->error_count == error_count && c->parse_status == OKAY && c->next_token == span->end;
+    c->declared_types = NULL;
+}
+
+bool all_declaration_spans_parsed_cleanly(void *context)
+{
+    DeclarationSpans *jobs = (DeclarationSpans *)context;
+    for (size_t i = 0; i < jobs->span_count; i++)
+    {
+        if (!jobs->spans[i].parsed_cleanly)
+            return false;
+    }
+    return true;
+}
+
+// Parse each global declaration on a pool of threads, and merge them in source order
+// Returns false if any declaration did not parse cleanly, so the program must be parsed sequentially
+// to recover from errors and report them exactly as it otherwise would.
+bool parse_program_block_in_parallel(Compiler *c, Program *apm, Block *program_block, Allocator *statements)
+{
+    DeclarationSpan *spans;
+    size_t span_count = find_declaration_spans(c, &spans);
+    if (span_count < 2)
+    {
+        free(spans);
+        return false;
+    }
+
+    // The worker arenas and expression chunks are released if any declaration fails, so nothing from the abandoned parse is kept
+    size_t expression_chunk_count = apm->expressions.chunk_count;
+    DeclarationSpans jobs = {.apm = apm, .program_block = program_block, .spans = spans, .span_count = span_count};
+    bool parsed_cleanly = run_compiler_jobs_or_discard(c, span_count, parse_declaration_span, (void *)&jobs, all_declaration_spans_parsed_cleanly);
+    if (!parsed_cleanly)
+        discard_expression_chunks(apm, expression_chunk_count);
+
+    for (size_t i = 0; i < span_count; i++)
+    {
+        DeclarationSpan *span = &spans[i];
+        if (parsed_cleanly)
+        {
+            intern_declared_types(apm, &span->declared_types);
+
+            Statement *stmt;
+            Iterator it = create_iterator(span->statements.first);
+            while (stmt = advance_iterator_of(&it, Statement))
+                *allocate(statements, Statement) = *stmt;
+
+            // Move the symbols out of the private table, so scopes inside the declaration fall through to the program block's
+            SymbolTable *table = span->symbol_table;
+            for (size_t j = 0; j < table->capacity; j++)
+            {
+                Symbol *symbol = &table->symbol[j];
+                if (symbol->tag != INVALID_SYMBOL)
+                    declare_symbol(&c->symbol_arena, program_block->symbol_table, symbol->tag, symbol->ptr, symbol->identity_atom);
+                symbol->tag = INVALID_SYMBOL;
+            }
+            table->symbol_count = 0;
+            table->next = program_block->symbol_table;
+        }
+
+        release_allocator(&span->statements);
+        release_allocator(&span->declared_types);
+    }
+
+    if (parsed_cleanly)
+        c->next_token = spans[span_count - 1].end;
+    c->parse_status = OKAY;
+    free(spans);
+    return parsed_cleanly;
 }
 
 // NOTE: Can return with status OKAY or RECOVERED
 Block *parse_block(Compiler *c, Program *apm, Block *parent)
 {
-    Block *block = allocate(&c->apm_allocator, Block);
+    Block *block = allocate(&c->block_arena, Block);
     block->declaration_block = false;
     block->singleton_block = false;
     block->symbol_table = parent->symbol_table;
@@ -815,7 +1167,7 @@ Block *parse_block(Compiler *c, Program *apm, Block *parent)
 
         // TODO: Make this more efficient. Currently we create a new symbol table for
         //       every block, meaning we create numerous completely empty tables.
-        block->symbol_table = allocate_symbol_table(&c->apm_allocator, parent->symbol_table);
+        block->symbol_table = allocate_symbol_table(&c->symbol_arena, parent->symbol_table);
 
         while (peek_statement(c))
             parse_statement(c, apm, &statement_allocator, block); // Can return with status OKAY or RECOVERED
@@ -824,35 +1176,53 @@ Block *parse_block(Compiler *c, Program *apm, Block *parent)
         recover_from_panic(c);
     }
 
-    block->statements = create_statement_list(&statement_allocator);
+    block->statements = create_statement_list(&c->list_arena, &statement_allocator);
 
     return block;
 }
 
 // NOTE: Can return with status OKAY, RECOVERED, or PANIC
-Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrecedence caller_precedence);
+ExpressionIndex parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrecedence caller_precedence);
 
-Expression *parse_expression(Compiler *c, Program *apm)
+ExpressionIndex parse_expression(Compiler *c, Program *apm)
 {
     return parse_expression_with_precedence(c, apm, PRECEDENCE_NONE);
 }
 
+// Identities are a single token, so their span is exactly that token
+ExpressionIndex parse_identity_literal(Compiler *c, Program *apm)
+{
+    ExpressionIndex index = add_expression(c, apm);
+    Expression *expr = get_expression(apm, index);
+    expr->kind = IDENTITY_LITERAL;
+    expr->identity_atom = TOKEN_ATOM();
+    expr->given_error = false;
+    *get_expression_span(apm, index) = TOKEN_STRING();
+    return index;
+}
+
 #define LEFT_ASSOCIATIVE_OPERATOR_BINDS(operator_precedence, caller_precedence) operator_precedence > caller_precedence
 #define RIGHT_ASSOCIATIVE_OPERATOR_BINDS(operator_precedence, caller_precedence) operator_precedence >= caller_precedence
 
+#define OPEN_EXPRESSION(expr_kind)          \
+    index = add_expression(c, apm);         \
+    expr = get_expression(apm, index);      \
+    expr->kind = expr_kind;
+
 #define PARSE_BINARY_OPERATION(token_kind, expr_kind)                                                          \
     else if (PEEK(token_kind) && LEFT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(expr_kind), caller_precedence)) \
     {                                                                                                          \
-        expr->kind = expr_kind;                                                                                \
+        OPEN_EXPRESSION(expr_kind);                                                                            \
         expr->lhs = lhs;                                                                                       \
         ADVANCE();                                                                                             \
         expr->rhs = parse_expression_with_precedence(c, apm, precedence_of(expr_kind));                        \
     }
 
-Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrecedence caller_precedence)
+ExpressionIndex parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrecedence caller_precedence)
 {
-    Expression *lhs = allocate(&c->apm_allocator, Expression);
-    START_SPAN(lhs);
+    ExpressionIndex lhs;
+    ExpressionIndex index;
+    Expression *expr;
 
     // Left-hand side of expression
     if (PEEK(PAREN_L))
@@ -863,127 +1233,105 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
     }
     else if (PEEK(IDENTITY))
     {
-        lhs->kind = IDENTITY_LITERAL;
-        lhs->identity = TOKEN_STRING();
-        lhs->given_error = false;
-        ADVANCE();
-    }
-    else if (PEEK(KEYWORD_TRUE))
-    {
-        lhs->kind = BOOLEAN_LITERAL;
-        lhs->bool_value = true;
-        ADVANCE();
-    }
-    else if (PEEK(KEYWORD_FALSE))
-    {
-        lhs->kind = BOOLEAN_LITERAL;
-        lhs->bool_value = false;
-        ADVANCE();
-    }
-    else if (PEEK(KEYWORD_NONE))
-    {
-        lhs->kind = NONE_LITERAL;
-        ADVANCE();
-    }
-    else if (PEEK(INTEGER))
-    {
-        substr str = TOKEN_STRING();
-
-        int num = 0;
-        for (size_t i = str.pos; i < str.pos + str.len; i++)
-            num = num * 10 + (c->source_text[i] - 48);
-
-        lhs->kind = INTEGER_LITERAL;
-        lhs->integer_value = num;
+        lhs = parse_identity_literal(c, apm);
         ADVANCE();
     }
-    else if (PEEK(RATIONAL))
+    else
     {
-        substr str = TOKEN_STRING();
+        lhs = add_expression(c, apm);
+        expr = get_expression(apm, lhs);
+        substr *span = get_expression_span(apm, lhs);
+        span->pos = TOKEN_STRING().pos;
 
-        int int_part = 0;
-        for (size_t i = str.pos; i < str.pos + str.len; i++)
+        if (PEEK(KEYWORD_TRUE))
         {
-            if (c->source_text[i] == '.')
-                break;
-            int_part = int_part * 10 + (c->source_text[i] - 48);
+            expr->kind = BOOLEAN_LITERAL;
+            expr->bool_value = true;
+            ADVANCE();
         }
-
-        double float_part = 0;
-        for (size_t i = str.pos + str.len - 1; i >= str.pos; i--)
+        else if (PEEK(KEYWORD_FALSE))
         {
-            if (c->source_text[i] == '.')
-                break;
-            float_part = (float_part + (c->source_text[i] - 48)) / 10;
+            expr->kind = BOOLEAN_LITERAL;
+            expr->bool_value = false;
+            ADVANCE();
+        }
+        else if (PEEK(KEYWORD_NONE))
+        {
+            expr->kind = NONE_LITERAL;
+            ADVANCE();
         }
+        else if (PEEK(INTEGER))
+        {
+            expr->kind = INTEGER_LITERAL;
+            expr->integer_value = TOKEN_VALUE().integer;
+            if (expr->integer_value < 0)
+                raise_compilation_error(c, INTEGER_LITERAL_IS_TOO_LARGE, TOKEN_STRING());
+            ADVANCE();
+        }
+        else if (PEEK(RATIONAL))
+        {
+            expr->kind = FLOAT_LITERAL;
+            expr->float_value = TOKEN_VALUE().rational;
+            ADVANCE();
+        }
+        else if (PEEK(STRING) || PEEK(BROKEN_STRING))
+        {
+            substr str = TOKEN_STRING();
+            str.pos++;
+            str.len -= PEEK(STRING) ? 2 : 1;
 
-        lhs->kind = FLOAT_LITERAL;
-        lhs->float_value = int_part + float_part;
-        ADVANCE();
-    }
-    else if (PEEK(STRING) || PEEK(BROKEN_STRING))
-    {
-        substr str = TOKEN_STRING();
-        str.pos++;
-        str.len -= PEEK(STRING) ? 2 : 1;
+            expr->kind = STRING_LITERAL;
+            expr->string_value = str;
+            ADVANCE();
+        }
+        else if (PEEK(PLUS))
+        {
+            expr->kind = UNARY_POS;
+            ADVANCE();
+            expr->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_POS));
+        }
+        else if (PEEK(MINUS))
+        {
+            expr->kind = UNARY_NEG;
+            ADVANCE();
+            expr->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_NEG));
+        }
+        else if (PEEK(KEYWORD_NOT))
+        {
+            expr->kind = UNARY_NOT;
+            ADVANCE();
+            expr->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_NOT));
+        }
+        else
+        {
+            expr->kind = INVALID_EXPRESSION;
+            span->len = TOKEN_STRING().pos - span->pos;
 
-        lhs->kind = STRING_LITERAL;
-        lhs->string_value = str;
-        ADVANCE();
-    }
-    else if (PEEK(PLUS))
-    {
-        lhs->kind = UNARY_POS;
-        ADVANCE();
-        lhs->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_POS));
-    }
-    else if (PEEK(MINUS))
-    {
-        lhs->kind = UNARY_NEG;
-        ADVANCE();
-        lhs->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_NEG));
-    }
-    else if (PEEK(KEYWORD_NOT))
-    {
-        lhs->kind = UNARY_NOT;
-        ADVANCE();
-        lhs->operand = parse_expression_with_precedence(c, apm, precedence_of(UNARY_NOT));
-    }
-    else
-    {
-        lhs->kind = INVALID_EXPRESSION;
-        END_SPAN(lhs);
+            raise_parse_error(c, EXPECTED_EXPRESSION);
 
-        raise_parse_error(c, EXPECTED_EXPRESSION);
+            // NOTE: parse_expression can put the parser in panic mode and then return.
+            //       This means anyone who calls parse_expression needs to be able to recover.
+            return lhs;
+        }
 
-        // NOTE: parse_expression can put the parser in panic mode and then return.
-        //       This means anyone who calls parse_expression needs to be able to recover.
-        return lhs;
+        span->len = TOKEN_STRING().pos - span->pos;
     }
 
-    END_SPAN(lhs);
-
     // Postfix operator OR infix operator and right-hand side expression
     while (true)
     {
-        // Open `expr`
-        Expression *expr = allocate(&c->apm_allocator, Expression);
-        expr->span.pos = lhs->span.pos;
-
         // Function call
         if (PEEK(PAREN_L) && LEFT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(FUNCTION_CALL), caller_precedence))
         {
-            expr->kind = FUNCTION_CALL;
-            expr->callee = lhs;
-
             Allocator arg_allocator;
             init_allocator(&arg_allocator);
+            uint32_t argument_count = 0;
 
             EAT(PAREN_L);
             while (peek_expression(c))
             {
-                Argument *arg = allocate(&arg_allocator, Argument);
-                arg->expr = parse_expression(c, apm);
+                *allocate(&arg_allocator, ExpressionIndex) = parse_expression(c, apm);
+                argument_count++;
 
                 if (!PEEK(COMMA))
                     break;
@@ -991,13 +1339,29 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
             }
             EAT(PAREN_R);
 
-            expr->arguments = create_argument_list(&arg_allocator);
+            // The arguments are stored directly after the call
+            index = add_expressions(c, apm, 1 + argument_count);
+            expr = get_expression(apm, index);
+            expr->kind = FUNCTION_CALL;
+            expr->callee = lhs;
+            expr->argument_count = argument_count;
+
+            ExpressionIndex *arg;
+            Iterator it = create_iterator(arg_allocator.first);
+            for (ExpressionIndex i = index + 1; arg = advance_iterator_of(&it, ExpressionIndex); i++)
+            {
+                Expression *argument = get_expression(apm, i);
+                argument->kind = ARGUMENT;
+                argument->argument = *arg;
+                *get_expression_span(apm, i) = *get_expression_span(apm, *arg);
+            }
+            release_allocator(&arg_allocator);
         }
 
         // Noneable
         else if (PEEK(QUESTION) && RIGHT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(NONEABLE_EXPRESSION), caller_precedence))
         {
-            expr->kind = NONEABLE_EXPRESSION;
+            OPEN_EXPRESSION(NONEABLE_EXPRESSION);
             expr->subject = lhs;
             ADVANCE();
         }
@@ -1005,7 +1369,7 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
         // Increment
         else if (PEEK(TWO_PLUS) && RIGHT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(UNARY_INCREMENT), caller_precedence))
         {
-            expr->kind = UNARY_INCREMENT;
+            OPEN_EXPRESSION(UNARY_INCREMENT);
             expr->operand = lhs;
             ADVANCE();
         }
@@ -1013,7 +1377,7 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
         // Decrement
         else if (PEEK(TWO_MINUS) && RIGHT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(UNARY_DECREMENT), caller_precedence))
         {
-            expr->kind = UNARY_DECREMENT;
+            OPEN_EXPRESSION(UNARY_DECREMENT);
             expr->operand = lhs;
             ADVANCE();
         }
@@ -1021,18 +1385,16 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
         // Index by field
         else if (PEEK(DOT) && LEFT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(INDEX_BY_FIELD), caller_precedence))
         {
-            expr->kind = INDEX_BY_FIELD;
-
+            OPEN_EXPRESSION(INDEX_BY_FIELD);
             expr->subject = lhs;
             EAT(DOT);
-            expr->field = TOKEN_STRING();
+            expr->field = parse_identity_literal(c, apm);
             EAT(IDENTITY);
         }
 
         else if (PEEK(TWO_DOT) && LEFT_ASSOCIATIVE_OPERATOR_BINDS(precedence_of(RANGE_LITERAL), caller_precedence))
         {
-            expr->kind = RANGE_LITERAL;
-
+            OPEN_EXPRESSION(RANGE_LITERAL);
             expr->first = lhs;
             EAT(TWO_DOT);
             expr->last = parse_expression_with_precedence(c, apm, precedence_of(RANGE_LITERAL));
@@ -1063,18 +1425,16 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
         // Logical or
         PARSE_BINARY_OPERATION(KEYWORD_OR, BINARY_LOGICAL_OR)
 
-        // Discard `expr` and finish parsing expression
+        // Finish parsing expression
         else
-        {
-            // FIXME: This wastes the memory that was allocated to this expression
-            expr->kind = INVALID_EXPRESSION;
             break;
-        }
 
-        // Close `expr` and continue parsing expression
-        END_SPAN(expr);
+        // Close `expr`, which spans from the start of its left-hand side, and continue parsing expression
+        substr *span = get_expression_span(apm, index);
+        span->pos = get_expression_span(apm, lhs)->pos;
+        span->len = TOKEN_STRING().pos - span->pos;
         recover_from_panic(c);
-        lhs = expr;
+        lhs = index;
     }
 
     return lhs;
@@ -1082,4 +1442,5 @@ Expression *parse_expression_with_precedence(Compiler *c, Program *apm, ExprPrec
 
 #undef LEFT_ASSOCIATIVE_OPERATOR_BINDS
 #undef RIGHT_ASSOCIATIVE_OPERATOR_BINDS
+#undef OPEN_EXPRESSION
 #undef PARSE_BINARY_OPERATION
@@ -4,7 +4,12 @@
 #include "core/core.h"
 #include "data/apm.h"
 #include "data/compiler.h"
+#include "tokenise.h"
 
 void parse(Compiler *compiler, Program *apm);
+void parse_lazy_function_body(Compiler *c, Program *apm, Function *funct);
+
+ExpressionIndex add_expressions(Compiler *c, Program *apm, size_t count);
+ExpressionIndex add_expression(Compiler *c, Program *apm);
 
 #endif
\ No newline at end of file
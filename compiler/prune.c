@@ -0,0 +1,298 @@
+#include "prune.h"
+
+// MARK REACHABLE //
+// Starting from `main` and the initial values of global variables, mark every
+// function and type that could be used while the program runs. Anything that
+// is not marked is never assembled.
+
+void mark_type(Program *apm, RhinoType ty);
+void mark_expression(Program *apm, const char *source_text, ExpressionIndex index);
+void mark_block(Program *apm, const char *source_text, Block *block);
+void mark_function(Program *apm, const char *source_text, Function *funct);
+
+void mark_type(Program *apm, RhinoType ty)
+{
+    TypeInfo *info = get_type_info(apm, ty);
+    switch (info->tag)
+    {
+    case RHINO_ENUM_TYPE:
+        info->enum_type->is_reachable = true;
+        break;
+
+    case RHINO_STRUCT_TYPE:
+    {
+        StructType *struct_type = info->struct_type;
+        if (struct_type->is_reachable)
+            break;
+
+        // Assembling the default value of a struct requires the default value of each property
+        struct_type->is_reachable = true;
+
+        Property *property;
+        Iterator it = create_iterator(&struct_type->properties);
+        while (property = advance_iterator_of(&it, Property))
+            mark_type(apm, property->type);
+
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void mark_expression(Program *apm, const char *source_text, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    switch (expr->kind)
+    {
+    case ENUM_VALUE_LITERAL:
+        expr->enum_value->type_of_enum_value->is_reachable = true;
+        break;
+
+    case VARIABLE_REFERENCE:
+        mark_type(apm, expr->variable->type);
+        break;
+
+    case FUNCTION_REFERENCE:
+        mark_function(apm, source_text, expr->function);
+        break;
+
+    case TYPE_REFERENCE:
+        mark_type(apm, expr->type);
+        break;
+
+    case FUNCTION_CALL:
+    {
+        mark_expression(apm, source_text, expr->callee);
+
+        for (size_t i = 0; i < expr->argument_count; i++)
+            mark_expression(apm, source_text, get_argument(apm, index, i));
+
+        break;
+    }
+
+    case INDEX_BY_FIELD:
+    case NONEABLE_EXPRESSION:
+        mark_expression(apm, source_text, expr->subject);
+        break;
+
+    case RANGE_LITERAL:
+        mark_expression(apm, source_text, expr->first);
+        mark_expression(apm, source_text, expr->last);
+        break;
+
+    case UNARY_POS:
+    case UNARY_NEG:
+    case UNARY_NOT:
+    case UNARY_INCREMENT:
+    case UNARY_DECREMENT:
+        mark_expression(apm, source_text, expr->operand);
+        break;
+
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_REMAINDER:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_LESS_THAN:
+    case BINARY_GREATER_THAN:
+    case BINARY_LESS_THAN_EQUAL:
+    case BINARY_GREATER_THAN_EQUAL:
+    case BINARY_EQUAL:
+    case BINARY_NOT_EQUAL:
+    case BINARY_LOGICAL_AND:
+    case BINARY_LOGICAL_OR:
+        mark_expression(apm, source_text, expr->lhs);
+        mark_expression(apm, source_text, expr->rhs);
+        break;
+
+    // Casting an enum to a string calls the enum's value_to_str unit
+    case TYPE_CAST:
+        mark_expression(apm, source_text, expr->cast_expr);
+        mark_type(apm, get_expression(apm, expr->cast_expr)->resolved_type);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void mark_block(Program *apm, const char *source_text, Block *block)
+{
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        switch (stmt->kind)
+        {
+        // Nested functions and types are only reachable if they are used
+        case FUNCTION_DECLARATION:
+        case ENUM_TYPE_DECLARATION:
+        case STRUCT_TYPE_DECLARATION:
+            break;
+
+        case VARIABLE_DECLARATION:
+            mark_type(apm, stmt->variable->type);
+            if (stmt->initial_value)
+                mark_expression(apm, source_text, stmt->initial_value);
+            break;
+
+        case CODE_BLOCK:
+            mark_block(apm, source_text, stmt->block);
+            break;
+
+        case IF_SEGMENT:
+        case ELSE_IF_SEGMENT:
+            mark_expression(apm, source_text, stmt->condition);
+            mark_block(apm, source_text, stmt->body);
+            break;
+
+        case ELSE_SEGMENT:
+        case BREAK_LOOP:
+            mark_block(apm, source_text, stmt->body);
+            break;
+
+        case FOR_LOOP:
+            mark_expression(apm, source_text, stmt->iterable);
+            mark_block(apm, source_text, stmt->body);
+            break;
+
+        case WHILE_LOOP:
+            mark_expression(apm, source_text, stmt->condition);
+            mark_block(apm, source_text, stmt->body);
+            break;
+
+        case ASSIGNMENT_STATEMENT:
+            mark_expression(apm, source_text, stmt->assignment_lhs);
+            mark_expression(apm, source_text, stmt->assignment_rhs);
+            break;
+
+        case OUTPUT_STATEMENT:
+        case EXPRESSION_STMT:
+        case RETURN_STATEMENT:
+            if (stmt->expression)
+                mark_expression(apm, source_text, stmt->expression);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void mark_function(Program *apm, const char *source_text, Function *funct)
+{
+    if (funct->is_reachable)
+        return;
+
+    funct->is_reachable = true;
+
+    mark_type(apm, funct->return_type);
+
+    Parameter *parameter;
+    Iterator it = create_iterator(&funct->parameters);
+    while (parameter = advance_iterator_of(&it, Parameter))
+        mark_type(apm, parameter->type);
+
+    mark_block(apm, source_text, funct->body);
+}
+
+// PRINT PRUNED //
+
+void printf_pruned_block(Program *apm, const char *source_text, Block *block, size_t *function_count, size_t *type_count);
+
+void printf_pruned_block(Program *apm, const char *source_text, Block *block, size_t *function_count, size_t *type_count)
+{
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        switch (stmt->kind)
+        {
+        case FUNCTION_DECLARATION:
+        {
+            Function *funct = stmt->function;
+            if (!funct->is_reachable)
+            {
+                printf("fn     ");
+                printf_substr(source_text, funct->identity);
+                printf("\n");
+                (*function_count)++;
+            }
+
+            // Nested functions and types of a pruned function are pruned with it, and so are also reported
+            if (funct->body)
+                printf_pruned_block(apm, source_text, funct->body, function_count, type_count);
+            break;
+        }
+
+        case ENUM_TYPE_DECLARATION:
+            if (!stmt->enum_type->is_reachable)
+            {
+                printf("enum   ");
+                printf_substr(source_text, stmt->enum_type->identity);
+                printf("\n");
+                (*type_count)++;
+            }
+            break;
+
+        case STRUCT_TYPE_DECLARATION:
+            if (!stmt->struct_type->is_reachable)
+            {
+                printf("struct ");
+                printf_substr(source_text, stmt->struct_type->identity);
+                printf("\n");
+                (*type_count)++;
+            }
+            printf_pruned_block(apm, source_text, stmt->struct_type->body, function_count, type_count);
+            break;
+
+        case CODE_BLOCK:
+            printf_pruned_block(apm, source_text, stmt->block, function_count, type_count);
+            break;
+
+        case IF_SEGMENT:
+        case ELSE_IF_SEGMENT:
+        case ELSE_SEGMENT:
+        case BREAK_LOOP:
+        case FOR_LOOP:
+        case WHILE_LOOP:
+            printf_pruned_block(apm, source_text, stmt->body, function_count, type_count);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void printf_pruned_apm(Program *apm, const char *source_text)
+{
+    size_t function_count = 0;
+    size_t type_count = 0;
+    printf_pruned_block(apm, source_text, apm->program_block, &function_count, &type_count);
+    printf("Dropped %zu functions and %zu types\n", function_count, type_count);
+}
+
+// PRUNE //
+
+void prune(Compiler *c, Program *apm)
+{
+    Block *program_block = apm->program_block;
+
+    // Global variables are always initialised, and so are always reachable
+    Statement *stmt;
+    Iterator it = create_iterator(&program_block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        if (stmt->kind != VARIABLE_DECLARATION)
+            continue;
+
+        mark_type(apm, stmt->variable->type);
+        if (stmt->initial_value)
+            mark_expression(apm, c->source_text, stmt->initial_value);
+    }
+
+    mark_function(apm, c->source_text, apm->main);
+}
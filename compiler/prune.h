@@ -0,0 +1,11 @@
+#ifndef PRUNE_H
+#define PRUNE_H
+
+#include "core/core.h"
+#include "data/apm.h"
+#include "data/compiler.h"
+
+void prune(Compiler *compiler, Program *apm);
+void printf_pruned_apm(Program *apm, const char *source_text);
+
+#endif
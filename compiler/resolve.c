@@ -1,9 +1,12 @@
 #include "resolve.h"
+#include "parse.h"
 
 // DETERMINE MAIN FUNCTION //
 
 void determine_main_function(Compiler *c, Program *apm)
 {
+    apm->main = NULL;
+
     Statement *declaration;
     Iterator it = create_iterator(&apm->program_block->statements);
     while (declaration = advance_iterator_of(&it, Statement))
@@ -11,7 +14,7 @@ void determine_main_function(Compiler *c, Program *apm)
         if (declaration->kind == FUNCTION_DECLARATION)
         {
             Function *funct = declaration->function;
-            if (substr_is(c->source_text, funct->identity, "main"))
+            if (funct->identity_atom == ATOM_MAIN)
             {
                 apm->main = funct;
                 return;
@@ -29,14 +32,18 @@ void determine_main_function(Compiler *c, Program *apm)
 // This is the first pass for resolving literals.
 // Other identity literals may be resolved in later passes.
 
-void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table);
+void resolve_identities_in_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table);
+void resolve_identities_in_variable_declaration(Compiler *c, Program *apm, Statement *stmt, SymbolTable *symbol_table);
 void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block);
 void resolve_identities_in_function(Compiler *c, Program *apm, Function *funct, SymbolTable *symbol_table);
+void resolve_identities_in_function_body(Compiler *c, Program *apm, Function *funct);
+void resolve_identities_in_lazy_function_body(Compiler *c, Program *apm, Function *funct);
 void resolve_identities_in_struct_type(Compiler *c, Program *apm, StructType *struct_type, SymbolTable *symbol_table);
 void resolve_identities_in_declaration_block(Compiler *c, Program *apm, Block *block);
 
-void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table)
+void resolve_identities_in_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table)
 {
+    Expression *expr = get_expression(apm, index);
     switch (expr->kind)
     {
     case INVALID_EXPRESSION:
@@ -46,28 +53,28 @@ void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *exp
     {
         // Native types
         // TODO: Implement these as types declared in the global scope which are not allowed to be shadowed
-        if (substr_is(c->source_text, expr->identity, "bool"))
+        if (expr->identity_atom == ATOM_BOOL)
         {
             expr->kind = TYPE_REFERENCE;
             expr->type = NATIVE_BOOL;
             break;
         }
 
-        if (substr_is(c->source_text, expr->identity, "int"))
+        if (expr->identity_atom == ATOM_INT)
         {
             expr->kind = TYPE_REFERENCE;
             expr->type = NATIVE_INT;
             break;
         }
 
-        if (substr_is(c->source_text, expr->identity, "num"))
+        if (expr->identity_atom == ATOM_NUM)
         {
             expr->kind = TYPE_REFERENCE;
             expr->type = NATIVE_NUM;
             break;
         }
 
-        if (substr_is(c->source_text, expr->identity, "str"))
+        if (expr->identity_atom == ATOM_STR)
         {
             expr->kind = TYPE_REFERENCE;
             expr->type = NATIVE_STR;
@@ -75,59 +82,40 @@ void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *exp
         }
 
         // Search symbol table
-        SymbolTable *current_table = symbol_table;
-        while (true)
-        {
-            bool found_symbol = false;
-            for (size_t i = 0; i < current_table->symbol_count; i++)
-            {
-                Symbol s = current_table->symbol[i];
-
-                if (!substr_match(c->source_text, s.identity, expr->identity))
-                    continue;
-
-                switch (s.tag)
-                {
-                case VARIABLE_SYMBOL:
-                    expr->kind = VARIABLE_REFERENCE;
-                    expr->variable = s.variable;
-                    break;
-
-                case PARAMETER_SYMBOL:
-                    expr->kind = PARAMETER_REFERENCE;
-                    expr->parameter = s.parameter;
-                    break;
-
-                case FUNCTION_SYMBOL:
-                    expr->kind = FUNCTION_REFERENCE;
-                    expr->function = s.function;
-                    break;
-
-                case ENUM_TYPE_SYMBOL:
-                    expr->kind = TYPE_REFERENCE;
-                    expr->type = ENUM_TYPE(s.enum_type);
-                    break;
+        Symbol *s = find_symbol(symbol_table, expr->identity_atom);
+        if (!s)
+            break;
 
-                case STRUCT_TYPE_SYMBOL:
-                    expr->kind = TYPE_REFERENCE;
-                    expr->type = STRUCT_TYPE(s.struct_type);
-                    break;
+        switch (s->tag)
+        {
+        case VARIABLE_SYMBOL:
+            expr->kind = VARIABLE_REFERENCE;
+            expr->variable = s->variable;
+            break;
 
-                default:
-                    fatal_error("Could not resolve IDENTITY_LITERAL that mapped to %s symbol.", symbol_tag_string(s.tag));
-                }
+        case PARAMETER_SYMBOL:
+            expr->kind = PARAMETER_REFERENCE;
+            expr->parameter = s->parameter;
+            break;
 
-                found_symbol = true;
-                break;
-            }
+        case FUNCTION_SYMBOL:
+            expr->kind = FUNCTION_REFERENCE;
+            expr->function = s->function;
+            resolve_identities_in_lazy_function_body(c, apm, s->function);
+            break;
 
-            if (found_symbol)
-                break;
+        case ENUM_TYPE_SYMBOL:
+            expr->kind = TYPE_REFERENCE;
+            expr->type = ENUM_TYPE(s->enum_type);
+            break;
 
-            if (current_table->next == NULL)
-                break;
+        case STRUCT_TYPE_SYMBOL:
+            expr->kind = TYPE_REFERENCE;
+            expr->type = STRUCT_TYPE(s->struct_type);
+            break;
 
-            current_table = current_table->next;
+        default:
+            fatal_error("Could not resolve IDENTITY_LITERAL that mapped to %s symbol.", symbol_tag_string(s->tag));
         }
 
         break;
@@ -150,21 +138,19 @@ void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *exp
     {
         resolve_identities_in_expression(c, apm, expr->callee, symbol_table);
 
-        Expression *callee = expr->callee;
+        Expression *callee = get_expression(apm, expr->callee);
         if (callee->kind == IDENTITY_LITERAL)
         {
-            raise_compilation_error(c, FUNCTION_DOES_NOT_EXIST, callee->span);
+            raise_compilation_error(c, FUNCTION_DOES_NOT_EXIST, *get_expression_span(apm, expr->callee));
             callee->given_error = true;
         }
         else if (callee->kind != FUNCTION_REFERENCE)
         {
-            raise_compilation_error(c, EXPRESSION_IS_NOT_A_FUNCTION, callee->span);
+            raise_compilation_error(c, EXPRESSION_IS_NOT_A_FUNCTION, *get_expression_span(apm, expr->callee));
         }
 
-        Argument *arg;
-        Iterator it = create_iterator(&expr->arguments);
-        while (arg = advance_iterator_of(&it, Argument))
-            resolve_identities_in_expression(c, apm, arg->expr, symbol_table);
+        for (size_t i = 0; i < expr->argument_count; i++)
+            resolve_identities_in_expression(c, apm, get_argument(apm, index, i), symbol_table);
 
         break;
     }
@@ -213,6 +199,15 @@ void resolve_identities_in_expression(Compiler *c, Program *apm, Expression *exp
     }
 }
 
+// NOTE: Does not declare the variable, as declaration blocks have already declared all of their symbols
+void resolve_identities_in_variable_declaration(Compiler *c, Program *apm, Statement *stmt, SymbolTable *symbol_table)
+{
+    if (stmt->initial_value)
+        resolve_identities_in_expression(c, apm, stmt->initial_value, symbol_table);
+    if (stmt->type_expression)
+        resolve_identities_in_expression(c, apm, stmt->type_expression, symbol_table);
+}
+
 void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
 {
     assert(!block->declaration_block);
@@ -228,7 +223,7 @@ void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
             continue;
 
         Function *funct = stmt->function;
-        declare_symbol(&c->apm_allocator, block->symbol_table, FUNCTION_SYMBOL, funct, funct->identity);
+        declare_symbol(&c->symbol_arena, block->symbol_table, FUNCTION_SYMBOL, funct, funct->identity_atom);
     }
 
     // Sequentially resolve identities in each statement, adding variables and types to the symbol table as they are encountered
@@ -242,13 +237,10 @@ void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
 
         case VARIABLE_DECLARATION:
         {
-            if (stmt->initial_value)
-                resolve_identities_in_expression(c, apm, stmt->initial_value, block->symbol_table);
-            if (stmt->type_expression)
-                resolve_identities_in_expression(c, apm, stmt->type_expression, block->symbol_table);
+            resolve_identities_in_variable_declaration(c, apm, stmt, block->symbol_table);
 
             Variable *var = stmt->variable;
-            declare_symbol(&c->apm_allocator, block->symbol_table, VARIABLE_SYMBOL, stmt->variable, var->identity);
+            declare_symbol(&c->symbol_arena, block->symbol_table, VARIABLE_SYMBOL, stmt->variable, var->identity_atom);
 
             break;
         }
@@ -260,7 +252,7 @@ void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
         case ENUM_TYPE_DECLARATION:
         {
             EnumType *enum_type = stmt->enum_type;
-            declare_symbol(&c->apm_allocator, block->symbol_table, ENUM_TYPE_SYMBOL, stmt->enum_type, enum_type->identity);
+            declare_symbol(&c->symbol_arena, block->symbol_table, ENUM_TYPE_SYMBOL, stmt->enum_type, enum_type->identity_atom);
 
             break;
         }
@@ -270,7 +262,7 @@ void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
             resolve_identities_in_struct_type(c, apm, stmt->struct_type, block->symbol_table);
 
             StructType *struct_type = stmt->struct_type;
-            declare_symbol(&c->apm_allocator, block->symbol_table, STRUCT_TYPE_SYMBOL, stmt->struct_type, struct_type->identity);
+            declare_symbol(&c->symbol_arena, block->symbol_table, STRUCT_TYPE_SYMBOL, stmt->struct_type, struct_type->identity_atom);
 
             break;
         }
@@ -298,7 +290,7 @@ void resolve_identities_in_code_block(Compiler *c, Program *apm, Block *block)
             resolve_identities_in_expression(c, apm, stmt->iterable, block->symbol_table);
 
             Variable *iterator = stmt->iterator;
-            declare_symbol(&c->apm_allocator, block->symbol_table, VARIABLE_SYMBOL, stmt->iterator, iterator->identity);
+            declare_symbol(&c->symbol_arena, block->symbol_table, VARIABLE_SYMBOL, stmt->iterator, iterator->identity_atom);
 
             resolve_identities_in_code_block(c, apm, stmt->body);
 
@@ -342,14 +334,33 @@ void resolve_identities_in_function(Compiler *c, Program *apm, Function *funct,
     Parameter *parameter;
     Iterator it = create_iterator(&funct->parameters);
     while (parameter = advance_iterator_of(&it, Parameter))
-    {
         resolve_identities_in_expression(c, apm, parameter->type_expression, symbol_table);
-        declare_symbol(&c->apm_allocator, funct->body->symbol_table, PARAMETER_SYMBOL, parameter, parameter->identity);
-    }
+
+    // Lazy bodies are resolved when they are first referenced
+    if (!funct->has_lazy_body)
+        resolve_identities_in_function_body(c, apm, funct);
+}
+
+void resolve_identities_in_function_body(Compiler *c, Program *apm, Function *funct)
+{
+    Parameter *parameter;
+    Iterator it = create_iterator(&funct->parameters);
+    while (parameter = advance_iterator_of(&it, Parameter))
+        declare_symbol(&c->symbol_arena, funct->body->symbol_table, PARAMETER_SYMBOL, parameter, parameter->identity_atom);
 
     resolve_identities_in_code_block(c, apm, funct->body);
 }
 
+// Parse and resolve the body of a lazily parsed function, if it has not been already
+void resolve_identities_in_lazy_function_body(Compiler *c, Program *apm, Function *funct)
+{
+    if (!funct->has_lazy_body || funct->body)
+        return;
+
+    parse_lazy_function_body(c, apm, funct);
+    resolve_identities_in_function_body(c, apm, funct);
+}
+
 void resolve_identities_in_struct_type(Compiler *c, Program *apm, StructType *struct_type, SymbolTable *symbol_table)
 {
     Property *property;
@@ -358,6 +369,27 @@ void resolve_identities_in_struct_type(Compiler *c, Program *apm, StructType *st
         resolve_identities_in_expression(c, apm, property->type_expression, struct_type->body->symbol_table);
 }
 
+typedef struct
+{
+    Program *apm;
+    Block *block;
+} DeclarationJobs;
+
+void resolve_identities_in_declaration(Compiler *c, void *context, size_t i)
+{
+    DeclarationJobs *jobs = (DeclarationJobs *)context;
+    Program *apm = jobs->apm;
+    Block *block = jobs->block;
+    Statement *stmt = get_statement(&block->statements, i);
+
+    if (stmt->kind == FUNCTION_DECLARATION)
+        resolve_identities_in_function(c, apm, stmt->function, block->symbol_table);
+    else if (stmt->kind == STRUCT_TYPE_DECLARATION)
+        resolve_identities_in_struct_type(c, apm, stmt->struct_type, block->symbol_table);
+    else if (stmt->kind == VARIABLE_DECLARATION)
+        resolve_identities_in_variable_declaration(c, apm, stmt, block->symbol_table);
+}
+
 void resolve_identities_in_declaration_block(Compiler *c, Program *apm, Block *block)
 {
     assert(block->declaration_block);
@@ -366,37 +398,25 @@ void resolve_identities_in_declaration_block(Compiler *c, Program *apm, Block *b
     //       and we add all symbols to the symbol table during parsing.
     //       Presumably, this may change at some point in the future?
 
-    Statement *stmt;
-    Iterator it = create_iterator(&block->statements);
-    while (stmt = advance_iterator_of(&it, Statement))
-    {
-        if (stmt->kind == FUNCTION_DECLARATION)
-            resolve_identities_in_function(c, apm, stmt->function, block->symbol_table);
-        else if (stmt->kind == STRUCT_TYPE_DECLARATION)
-            resolve_identities_in_struct_type(c, apm, stmt->struct_type, block->symbol_table);
-        else if (stmt->kind == VARIABLE_DECLARATION)
-        {
-            // TODO: This is copy/pasted and modified from resolve_identities_in_code_block.
-            //       Find an effective way to tidy.
-            if (stmt->initial_value)
-                resolve_identities_in_expression(c, apm, stmt->initial_value, block->symbol_table);
-            if (stmt->type_expression)
-                resolve_identities_in_expression(c, apm, stmt->type_expression, block->symbol_table);
-        }
-    }
+    // Each declaration only declares symbols in its own scopes, so they can be resolved in parallel
+    DeclarationJobs jobs = {.apm = apm, .block = block};
+    run_compiler_jobs(c, block->statements.count, resolve_identities_in_declaration, (void *)&jobs);
 }
 
 // RESOLVE TYPES //
 
-RhinoType resolve_type_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table);
-void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table, RhinoType type_hint);
+RhinoType resolve_type_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table);
+void resolve_types_in_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table, RhinoType type_hint);
+void find_field_property(Program *apm, ExpressionIndex index);
+RhinoType update_expression_types(Program *apm, ExpressionIndex index);
 void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block);
-void resolve_types_in_function(Compiler *c, Program *apm, Function *funct, SymbolTable *symbol_table);
+void resolve_types_in_function_signature(Compiler *c, Program *apm, Function *funct, SymbolTable *symbol_table);
 void resolve_types_in_struct_type(Compiler *c, Program *apm, StructType *struct_type, SymbolTable *symbol_table);
 void resolve_types_in_declaration_block(Compiler *c, Program *apm, Block *block);
 
-RhinoType resolve_type_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table)
+RhinoType resolve_type_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table)
 {
+    Expression *expr = get_expression(apm, index);
     // FIXME: At the moment `parse_expression` will give a "expected expression" error whenever a type
     //        expression is invalid. Find a way of handling this that gives more helpful/specific errors.
     if (expr->kind == INVALID_EXPRESSION)
@@ -407,7 +427,7 @@ RhinoType resolve_type_expression(Compiler *c, Program *apm, Expression *expr, S
 
     if (expr->kind == IDENTITY_LITERAL)
     {
-        raise_compilation_error(c, TYPE_DOES_NOT_EXIST, expr->span);
+        raise_compilation_error(c, TYPE_DOES_NOT_EXIST, *get_expression_span(apm, index));
         expr->given_error = true;
         return ERROR_TYPE;
     }
@@ -415,9 +435,11 @@ RhinoType resolve_type_expression(Compiler *c, Program *apm, Expression *expr, S
     if (expr->kind == NONEABLE_EXPRESSION)
     {
         RhinoType ty = resolve_type_expression(c, apm, expr->subject, symbol_table);
+        if (!IS_VALID_TYPE(ty))
+            return ty;
+
         // FIXME: If type is already noneable, this should be an error
-        ty.is_noneable = true;
-        return ty;
+        return get_noneable_type(apm, ty);
     }
 
     if (expr->kind == INDEX_BY_FIELD)
@@ -427,54 +449,43 @@ RhinoType resolve_type_expression(Compiler *c, Program *apm, Expression *expr, S
         if (!IS_VALID_TYPE(subject_type))
             return ERROR_TYPE; // Return immediately, no need to produce an additional error
 
-        if (subject_type.tag == RHINO_STRUCT_TYPE)
+        TypeInfo *subject = get_type_info(apm, subject_type);
+        if (subject->tag == RHINO_STRUCT_TYPE)
         {
-            StructType *struct_type = subject_type.struct_type;
-            SymbolTable *current_table = struct_type->body->symbol_table;
+            StructType *struct_type = subject->struct_type;
+            Symbol *s = find_symbol(struct_type->body->symbol_table, get_expression(apm, expr->field)->identity_atom);
 
-            while (true)
+            if (!s)
             {
-                for (size_t i = 0; i < current_table->symbol_count; i++)
-                {
-                    Symbol s = current_table->symbol[i];
-
-                    if (!substr_match(c->source_text, s.identity, expr->field))
-                        continue;
-
-                    switch (s.tag)
-                    {
-                    case ENUM_TYPE_SYMBOL:
-                        expr->kind = TYPE_REFERENCE;
-                        expr->type = ENUM_TYPE(s.enum_type);
-                        return expr->type;
-
-                    case STRUCT_TYPE_SYMBOL:
-                        expr->kind = TYPE_REFERENCE;
-                        expr->type = STRUCT_TYPE(s.struct_type);
-                        return expr->type;
-
-                    default:
-                        fatal_error("Could not resolve IDENTITY_LITERAL that mapped to %s symbol inside of struct type.", symbol_tag_string(s.tag));
-                    }
-                }
-
-                if (current_table->next == NULL)
-                    break;
-
-                current_table = current_table->next;
+                raise_compilation_error(c, TYPE_DOES_NOT_EXIST, *get_expression_span(apm, index));
+                return ERROR_TYPE;
             }
 
-            raise_compilation_error(c, TYPE_DOES_NOT_EXIST, expr->span);
-            return ERROR_TYPE;
+            switch (s->tag)
+            {
+            case ENUM_TYPE_SYMBOL:
+                expr->kind = TYPE_REFERENCE;
+                expr->type = ENUM_TYPE(s->enum_type);
+                return expr->type;
+
+            case STRUCT_TYPE_SYMBOL:
+                expr->kind = TYPE_REFERENCE;
+                expr->type = STRUCT_TYPE(s->struct_type);
+                return expr->type;
+
+            default:
+                fatal_error("Could not resolve IDENTITY_LITERAL that mapped to %s symbol inside of struct type.", symbol_tag_string(s->tag));
+            }
         }
     }
 
-    raise_compilation_error(c, TYPE_IS_INVALID, expr->span);
+    raise_compilation_error(c, TYPE_IS_INVALID, *get_expression_span(apm, index));
     return ERROR_TYPE;
 }
 
-void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, SymbolTable *symbol_table, RhinoType type_hint)
+void resolve_types_in_expression(Compiler *c, Program *apm, ExpressionIndex index, SymbolTable *symbol_table, RhinoType type_hint)
 {
+    Expression *expr = get_expression(apm, index);
     switch (expr->kind)
     {
     case INVALID_EXPRESSION:
@@ -482,18 +493,19 @@ void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, Sy
 
     case IDENTITY_LITERAL:
     {
-        if (type_hint.tag == RHINO_ENUM_TYPE)
+        TypeInfo *hint = get_type_info(apm, type_hint);
+        if (hint->tag == RHINO_ENUM_TYPE)
         {
-            EnumType *enum_type = type_hint.enum_type;
+            EnumType *enum_type = hint->enum_type;
             EnumValue *enum_value;
             Iterator it = create_iterator(&enum_type->values);
             while (enum_value = advance_iterator_of(&it, EnumValue))
             {
-                if (substr_match(c->source_text, expr->identity, enum_value->identity))
+                if (expr->identity_atom == enum_value->identity_atom)
                 {
                     expr->kind = ENUM_VALUE_LITERAL;
                     expr->enum_value = enum_value;
-                    return;
+                    break;
                 }
             }
         }
@@ -519,10 +531,8 @@ void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, Sy
         resolve_types_in_expression(c, apm, expr->callee, symbol_table, NATIVE_NONE);
 
         // TODO: Use the parameter types as type hints for the arguments
-        Argument *arg;
-        Iterator it = create_iterator(&expr->arguments);
-        while (arg = advance_iterator_of(&it, Argument))
-            resolve_types_in_expression(c, apm, arg->expr, symbol_table, NATIVE_NONE);
+        for (size_t i = 0; i < expr->argument_count; i++)
+            resolve_types_in_expression(c, apm, get_argument(apm, index, i), symbol_table, NATIVE_NONE);
 
         break;
     }
@@ -532,27 +542,32 @@ void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, Sy
         resolve_types_in_expression(c, apm, expr->subject, symbol_table, NATIVE_NONE);
 
         // Resolve enum values
-        Expression *subject = expr->subject;
+        Expression *subject = get_expression(apm, expr->subject);
         if (subject->kind != TYPE_REFERENCE)
-            return;
+        {
+            find_field_property(apm, index);
+            break;
+        }
 
-        if (subject->type.tag != RHINO_ENUM_TYPE)
-            return;
+        TypeInfo *subject_type = get_type_info(apm, subject->type);
+        if (subject_type->tag != RHINO_ENUM_TYPE)
+            break;
 
-        EnumType *enum_type = subject->type.enum_type;
+        EnumType *enum_type = subject_type->enum_type;
         EnumValue *enum_value;
         Iterator it = create_iterator(&enum_type->values);
         while (enum_value = advance_iterator_of(&it, EnumValue))
         {
-            if (substr_match(c->source_text, expr->field, enum_value->identity))
+            if (get_expression(apm, expr->field)->identity_atom == enum_value->identity_atom)
             {
                 expr->kind = ENUM_VALUE_LITERAL;
                 expr->enum_value = enum_value;
-                return;
+                break;
             }
         }
 
-        raise_compilation_error(c, ENUM_VALUE_DOES_NOT_EXIST, expr->span);
+        if (expr->kind != ENUM_VALUE_LITERAL)
+            raise_compilation_error(c, ENUM_VALUE_DOES_NOT_EXIST, *get_expression_span(apm, index));
         break;
     }
 
@@ -590,6 +605,83 @@ void resolve_types_in_expression(Compiler *c, Program *apm, Expression *expr, Sy
         fatal_error("Could not resolve types in %s expression", expression_kind_string(expr->kind));
         break;
     }
+
+    // Subexpressions have been resolved, so their types are already stored
+    expr->resolved_type = determine_expression_type(apm, expr);
+}
+
+// Find the property being indexed now, so later passes do not need to search for it
+// The field is turned into a reference to the property
+void find_field_property(Program *apm, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    TypeInfo *subject_type = get_type_info(apm, get_expression(apm, expr->subject)->resolved_type);
+    if (subject_type->tag != RHINO_STRUCT_TYPE)
+        return;
+
+    Expression *field = get_expression(apm, expr->field);
+    Property *property;
+    Iterator it = create_iterator(&subject_type->struct_type->properties);
+    while (property = advance_iterator_of(&it, Property))
+    {
+        if (property->identity_atom == field->identity_atom)
+        {
+            field->kind = PROPERTY_REFERENCE;
+            field->property = property;
+            field->resolved_type = determine_expression_type(apm, field);
+            return;
+        }
+    }
+}
+
+// Redetermine the stored types of an expression that refers to variables whose types have since been inferred
+RhinoType update_expression_types(Program *apm, ExpressionIndex index)
+{
+    Expression *expr = get_expression(apm, index);
+    switch (expr->kind)
+    {
+    case FUNCTION_CALL:
+        for (size_t i = 0; i < expr->argument_count; i++)
+            update_expression_types(apm, get_argument(apm, index, i));
+        break;
+
+    case INDEX_BY_FIELD:
+        update_expression_types(apm, expr->subject);
+        if (get_expression(apm, expr->subject)->kind != TYPE_REFERENCE && get_expression(apm, expr->field)->kind == IDENTITY_LITERAL)
+            find_field_property(apm, index);
+        break;
+
+    case UNARY_POS:
+    case UNARY_NEG:
+    case UNARY_NOT:
+    case UNARY_INCREMENT:
+    case UNARY_DECREMENT:
+        update_expression_types(apm, expr->operand);
+        break;
+
+    case BINARY_MULTIPLY:
+    case BINARY_DIVIDE:
+    case BINARY_REMAINDER:
+    case BINARY_ADD:
+    case BINARY_SUBTRACT:
+    case BINARY_LESS_THAN:
+    case BINARY_GREATER_THAN:
+    case BINARY_LESS_THAN_EQUAL:
+    case BINARY_GREATER_THAN_EQUAL:
+    case BINARY_EQUAL:
+    case BINARY_NOT_EQUAL:
+    case BINARY_LOGICAL_AND:
+    case BINARY_LOGICAL_OR:
+        update_expression_types(apm, expr->lhs);
+        update_expression_types(apm, expr->rhs);
+        break;
+
+    default:
+        break;
+    }
+
+    expr->resolved_type = determine_expression_type(apm, expr);
+    return expr->resolved_type;
 }
 
 void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
@@ -597,7 +689,17 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
     assert(!block->declaration_block);
 
     Statement *stmt;
-    Iterator it = create_iterator(&block->statements);
+    Iterator it;
+
+    // Resolve function signatures first, as functions can be called before they are declared
+    it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        if (stmt->kind == FUNCTION_DECLARATION)
+            resolve_types_in_function_signature(c, apm, stmt->function, block->symbol_table);
+    }
+
+    it = create_iterator(&block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
     {
         switch (stmt->kind)
@@ -609,7 +711,7 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
         case VARIABLE_DECLARATION:
         {
             Variable *var = stmt->variable;
-            var->type.tag = RHINO_INVALID_TYPE_TAG;
+            var->type = INVALID_TYPE;
 
             if (stmt->type_expression)
             {
@@ -621,7 +723,7 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
             else if (stmt->initial_value)
             {
                 resolve_types_in_expression(c, apm, stmt->initial_value, block->symbol_table, NATIVE_NONE);
-                var->type = get_expression_type(apm, c->source_text, stmt->initial_value);
+                var->type = get_expression(apm, stmt->initial_value)->resolved_type;
             }
             else
             {
@@ -632,8 +734,10 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
             break;
         }
 
+        // Lazy bodies that were never referenced are never parsed
         case FUNCTION_DECLARATION:
-            resolve_types_in_function(c, apm, stmt->function, block->symbol_table);
+            if (stmt->function->body)
+                resolve_types_in_code_block(c, apm, stmt->function->body);
             break;
 
         case ENUM_TYPE_DECLARATION:
@@ -667,14 +771,14 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
             resolve_types_in_expression(c, apm, stmt->iterable, block->symbol_table, NATIVE_NONE);
 
             Variable *iterator = stmt->iterator;
-            Expression *iterable = stmt->iterable;
+            Expression *iterable = get_expression(apm, stmt->iterable);
             if (iterable->kind == RANGE_LITERAL)
             {
                 iterator->type = NATIVE_INT;
             }
-            else if (iterable->kind == TYPE_REFERENCE && iterable->type.tag == RHINO_ENUM_TYPE)
+            else if (iterable->kind == TYPE_REFERENCE && get_type_info(apm, iterable->type)->tag == RHINO_ENUM_TYPE)
             {
-                iterator->type = ENUM_TYPE(iterable->type.enum_type);
+                iterator->type = iterable->type;
             }
             else
             {
@@ -696,7 +800,7 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
         case ASSIGNMENT_STATEMENT:
         {
             resolve_types_in_expression(c, apm, stmt->assignment_lhs, block->symbol_table, NATIVE_NONE);
-            RhinoType lhs_type = get_expression_type(apm, c->source_text, stmt->assignment_lhs);
+            RhinoType lhs_type = get_expression(apm, stmt->assignment_lhs)->resolved_type;
             resolve_types_in_expression(c, apm, stmt->assignment_rhs, block->symbol_table, lhs_type);
             break;
         }
@@ -708,15 +812,18 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
             {
                 resolve_types_in_expression(c, apm, stmt->expression, block->symbol_table, NATIVE_STR);
 
-                RhinoType expr_type = get_expression_type(apm, c->source_text, stmt->expression);
-                if (!is_native_type(expr_type, &apm->str_type))
+                RhinoType expr_type = get_expression(apm, stmt->expression)->resolved_type;
+                if (!IS_STR_TYPE(expr_type))
                 {
-                    Expression *cast = allocate(&c->apm_allocator, Expression);
-                    cast->span = stmt->expression->span;
+                    ExpressionIndex cast_index = add_expression(c, apm);
+                    *get_expression_span(apm, cast_index) = *get_expression_span(apm, stmt->expression);
+
+                    Expression *cast = get_expression(apm, cast_index);
                     cast->kind = TYPE_CAST;
                     cast->cast_type = NATIVE_STR;
                     cast->cast_expr = stmt->expression;
-                    stmt->expression = cast;
+                    cast->resolved_type = NATIVE_STR;
+                    stmt->expression = cast_index;
                 }
             }
             break;
@@ -738,7 +845,7 @@ void resolve_types_in_code_block(Compiler *c, Program *apm, Block *block)
     }
 }
 
-void resolve_types_in_function(Compiler *c, Program *apm, Function *funct, SymbolTable *symbol_table)
+void resolve_types_in_function_signature(Compiler *c, Program *apm, Function *funct, SymbolTable *symbol_table)
 {
     if (funct->has_return_type_expression)
         funct->return_type = resolve_type_expression(c, apm, funct->return_type_expression, symbol_table);
@@ -751,8 +858,6 @@ void resolve_types_in_function(Compiler *c, Program *apm, Function *funct, Symbo
     {
         parameter->type = resolve_type_expression(c, apm, parameter->type_expression, symbol_table);
     }
-
-    resolve_types_in_code_block(c, apm, funct->body);
 }
 
 void resolve_types_in_struct_type(Compiler *c, Program *apm, StructType *struct_type, SymbolTable *symbol_table)
@@ -763,6 +868,16 @@ void resolve_types_in_struct_type(Compiler *c, Program *apm, StructType *struct_
         property->type = resolve_type_expression(c, apm, property->type_expression, struct_type->body->symbol_table);
 }
 
+void resolve_types_in_function_body(Compiler *c, void *context, size_t i)
+{
+    DeclarationJobs *jobs = (DeclarationJobs *)context;
+    Statement *stmt = get_statement(&jobs->block->statements, i);
+
+    // Lazy bodies that were never referenced are never parsed
+    if (stmt->kind == FUNCTION_DECLARATION && stmt->function->body)
+        resolve_types_in_code_block(c, jobs->apm, stmt->function->body);
+}
+
 void resolve_types_in_declaration_block(Compiler *c, Program *apm, Block *block)
 {
     assert(block->declaration_block);
@@ -770,6 +885,16 @@ void resolve_types_in_declaration_block(Compiler *c, Program *apm, Block *block)
     Statement *stmt;
     Iterator it;
 
+    // Resolve structs and function signatures, which initial values may depend on
+    it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        if (stmt->kind == FUNCTION_DECLARATION)
+            resolve_types_in_function_signature(c, apm, stmt->function, block->symbol_table);
+        if (stmt->kind == STRUCT_TYPE_DECLARATION)
+            resolve_types_in_struct_type(c, apm, stmt->struct_type, block->symbol_table);
+    }
+
     // Resolve types in variable declarations
     it = create_iterator(&block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
@@ -794,16 +919,16 @@ void resolve_types_in_declaration_block(Compiler *c, Program *apm, Block *block)
         it = create_iterator(&block->statements);
         while (stmt = advance_iterator_of(&it, Statement))
         {
-            if (stmt->kind == VARIABLE_DECLARATION && !stmt->type_expression && stmt->variable->type.tag == RHINO_UNINITIALISED_TYPE_TAG)
+            if (stmt->kind == VARIABLE_DECLARATION && !stmt->type_expression && stmt->variable->type == UNINITIALISED_TYPE)
             {
                 Variable *var = stmt->variable;
 
                 if (stmt->initial_value)
-                    var->type = get_expression_type(apm, c->source_text, stmt->initial_value);
+                    var->type = update_expression_types(apm, stmt->initial_value);
                 else
-                    var->type.tag = RHINO_ERROR_TYPE;
+                    var->type = ERROR_TYPE;
 
-                if (var->type.tag != RHINO_UNINITIALISED_TYPE_TAG)
+                if (var->type != UNINITIALISED_TYPE)
                     changes_made = true;
             }
         }
@@ -812,35 +937,134 @@ void resolve_types_in_declaration_block(Compiler *c, Program *apm, Block *block)
     it = create_iterator(&block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
     {
-        if (stmt->kind == VARIABLE_DECLARATION && stmt->variable->type.tag == RHINO_UNINITIALISED_TYPE_TAG)
+        if (stmt->kind == VARIABLE_DECLARATION && stmt->variable->type == UNINITIALISED_TYPE)
         {
-            stmt->variable->type.tag = RHINO_INVALID_TYPE_TAG;
+            stmt->variable->type = INVALID_TYPE;
             // TODO: What should happen in this situation?
         }
     }
 
-    // Resolve structs and functions
-    it = create_iterator(&block->statements);
-    while (stmt = advance_iterator_of(&it, Statement))
+    // Function bodies only depend on the declarations resolved above, so they can be resolved in parallel
+    DeclarationJobs jobs = {.apm = apm, .block = block};
+    run_compiler_jobs(c, block->statements.count, resolve_types_in_function_body, (void *)&jobs);
+}
+
+// RESOLVE INITIALISATION ORDER //
+
+// Global variables and the functions reachable from their initial values form a dependency graph, with an edge for
+// every variable or function referenced, which is ordered using Tarjan's strongly connected components algorithm.
+
+typedef struct DependencyNode DependencyNode;
+struct DependencyNode
+{
+    void *ptr;              // The Variable or Function this node is for
+    Statement *declaration; // The declaration of a global variable, or NULL for a function
+    uint32_t index;         // The order nodes are first visited in, or 0 if this node has not been visited yet
+    uint32_t lowlink;       // The smallest index of any node on the stack reachable from this one
+    bool on_stack;
+    bool depends_on_itself;
+    DependencyNode *below; // The node beneath this one on the stack
+};
+
+typedef struct
+{
+    Compiler *c;
+    Program *apm;
+    Allocator allocator;
+    DependencyNode **slot; // Open addressed hash table of nodes, keyed by their ptr
+    size_t node_count;
+    size_t capacity;
+    DependencyNode *stack;
+    uint32_t next_index;
+    Block *block;
+} DependencyGraph;
+
+#define INITIAL_DEPENDENCY_GRAPH_CAPACITY 64
+
+void add_dependencies_of_expression(DependencyGraph *graph, DependencyNode *node, ExpressionIndex index);
+void add_dependencies_of_block(DependencyGraph *graph, DependencyNode *node, Block *block);
+void add_dependencies_of_statement(DependencyGraph *graph, DependencyNode *node, Statement *stmt);
+void order_strongly_connected_nodes(DependencyGraph *graph, DependencyNode *node);
+
+size_t dependency_node_slot(DependencyGraph *graph, void *ptr)
+{
+    size_t hash = ((size_t)ptr >> 3) * 2654435769u;
+    size_t i = (hash ^ (hash >> 16)) & (graph->capacity - 1);
+    while (graph->slot[i] && graph->slot[i]->ptr != ptr)
+        i = (i + 1) & (graph->capacity - 1);
+    return i;
+}
+
+DependencyNode *find_dependency_node(DependencyGraph *graph, void *ptr)
+{
+    return graph->slot[dependency_node_slot(graph, ptr)];
+}
+
+DependencyNode *add_dependency_node(DependencyGraph *graph, void *ptr, Statement *declaration)
+{
+    // Keep the load factor at or below three quarters
+    if ((graph->node_count + 1) * 4 > graph->capacity * 3)
     {
-        if (stmt->kind == FUNCTION_DECLARATION)
-            resolve_types_in_function(c, apm, stmt->function, block->symbol_table);
-        if (stmt->kind == STRUCT_TYPE_DECLARATION)
-            resolve_types_in_struct_type(c, apm, stmt->struct_type, block->symbol_table);
+        DependencyNode **old_slot = graph->slot;
+        size_t old_capacity = graph->capacity;
+
+        graph->capacity = old_capacity == 0 ? INITIAL_DEPENDENCY_GRAPH_CAPACITY : old_capacity * 2;
+        graph->slot = (DependencyNode **)allocate_chunk(&graph->allocator, sizeof(DependencyNode *) * graph->capacity, alignof(DependencyNode *));
+        memset(graph->slot, 0, sizeof(DependencyNode *) * graph->capacity);
+
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            if (old_slot[i])
+                graph->slot[dependency_node_slot(graph, old_slot[i]->ptr)] = old_slot[i];
+        }
     }
+
+    DependencyNode **slot = &graph->slot[dependency_node_slot(graph, ptr)];
+    if (*slot)
+        return *slot;
+
+    DependencyNode *node = allocate(&graph->allocator, DependencyNode);
+    node->ptr = ptr;
+    node->declaration = declaration;
+    node->index = 0;
+    node->lowlink = 0;
+    node->on_stack = false;
+    node->depends_on_itself = false;
+    node->below = NULL;
+
+    *slot = node;
+    graph->node_count++;
+    return node;
 }
 
-// RESOLVE VARIABLE ORDERS //
+void add_dependency(DependencyGraph *graph, DependencyNode *node, DependencyNode *dependency)
+{
+    if (dependency == node)
+    {
+        node->depends_on_itself = true;
+    }
+    else if (dependency->index == 0)
+    {
+        order_strongly_connected_nodes(graph, dependency);
+        if (dependency->lowlink < node->lowlink)
+            node->lowlink = dependency->lowlink;
+    }
+    else if (dependency->on_stack)
+    {
+        if (dependency->index < node->lowlink)
+            node->lowlink = dependency->index;
+    }
+}
 
-size_t determine_order_of_expression(Compiler *c, Program *apm, Expression *expr)
+void add_dependencies_of_expression(DependencyGraph *graph, DependencyNode *node, ExpressionIndex index)
 {
+    Program *apm = graph->apm;
+    Expression *expr = get_expression(apm, index);
     switch (expr->kind)
     {
     case INVALID_EXPRESSION:
-        return 0;
-
     case IDENTITY_LITERAL:
-        return 0;
+        break;
 
     case NONE_LITERAL:
     case INTEGER_LITERAL:
@@ -848,45 +1072,51 @@ size_t determine_order_of_expression(Compiler *c, Program *apm, Expression *expr
     case BOOLEAN_LITERAL:
     case STRING_LITERAL:
     case ENUM_VALUE_LITERAL:
-        return 0;
+        break;
 
     case VARIABLE_REFERENCE:
-        return expr->variable->order;
+    {
+        // Only global variables are in the graph, local variables are always initialised before they are used
+        DependencyNode *dependency = find_dependency_node(graph, expr->variable);
+        if (dependency)
+            add_dependency(graph, node, dependency);
+        break;
+    }
 
     case FUNCTION_REFERENCE:
+        add_dependency(graph, node, add_dependency_node(graph, expr->function, NULL));
+        break;
+
     case PARAMETER_REFERENCE:
     case TYPE_REFERENCE:
-        return 0;
+        break;
 
     case FUNCTION_CALL:
     {
-        size_t largest_order = 0;
-        Argument *arg;
-        Iterator it = create_iterator(&expr->arguments);
-        while (arg = advance_iterator_of(&it, Argument))
-        {
-            size_t order = determine_order_of_expression(c, apm, arg->expr);
-            if (order > largest_order)
-                largest_order = order;
-        }
-        return largest_order;
+        add_dependencies_of_expression(graph, node, expr->callee);
+
+        for (size_t i = 0; i < expr->argument_count; i++)
+            add_dependencies_of_expression(graph, node, get_argument(apm, index, i));
+
+        break;
     }
+
     case INDEX_BY_FIELD:
-        return determine_order_of_expression(c, apm, expr->subject);
+        add_dependencies_of_expression(graph, node, expr->subject);
+        break;
 
     case RANGE_LITERAL:
-    {
-        size_t first = determine_order_of_expression(c, apm, expr->first);
-        size_t last = determine_order_of_expression(c, apm, expr->last);
-        return first > last ? first : last;
-    }
+        add_dependencies_of_expression(graph, node, expr->first);
+        add_dependencies_of_expression(graph, node, expr->last);
+        break;
 
     case UNARY_POS:
     case UNARY_NEG:
     case UNARY_NOT:
     case UNARY_INCREMENT:
     case UNARY_DECREMENT:
-        return determine_order_of_expression(c, apm, expr->operand);
+        add_dependencies_of_expression(graph, node, expr->operand);
+        break;
 
     case BINARY_MULTIPLY:
     case BINARY_DIVIDE:
@@ -901,61 +1131,184 @@ size_t determine_order_of_expression(Compiler *c, Program *apm, Expression *expr
     case BINARY_NOT_EQUAL:
     case BINARY_LOGICAL_AND:
     case BINARY_LOGICAL_OR:
-    {
-        size_t lhs = determine_order_of_expression(c, apm, expr->lhs);
-        size_t rhs = determine_order_of_expression(c, apm, expr->rhs);
-        return lhs > rhs ? lhs : rhs;
+        add_dependencies_of_expression(graph, node, expr->lhs);
+        add_dependencies_of_expression(graph, node, expr->rhs);
+        break;
+
+    case TYPE_CAST:
+        add_dependencies_of_expression(graph, node, expr->cast_expr);
+        break;
+
+    default:
+        fatal_error("Could not determine dependencies of %s expression", expression_kind_string(expr->kind));
+        break;
     }
+}
+
+void add_dependencies_of_block(DependencyGraph *graph, DependencyNode *node, Block *block)
+{
+    Statement *stmt;
+    Iterator it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+        add_dependencies_of_statement(graph, node, stmt);
+}
+
+void add_dependencies_of_statement(DependencyGraph *graph, DependencyNode *node, Statement *stmt)
+{
+    switch (stmt->kind)
+    {
+    case INVALID_STATEMENT:
+        break;
+
+    case VARIABLE_DECLARATION:
+        if (stmt->initial_value)
+            add_dependencies_of_expression(graph, node, stmt->initial_value);
+        break;
+
+    // Nested functions only run when they are called, which is an edge of its own
+    case FUNCTION_DECLARATION:
+    case ENUM_TYPE_DECLARATION:
+    case STRUCT_TYPE_DECLARATION:
+        break;
+
+    case CODE_BLOCK:
+        add_dependencies_of_block(graph, node, stmt->block);
+        break;
+
+    case IF_SEGMENT:
+    case ELSE_IF_SEGMENT:
+    case WHILE_LOOP:
+        add_dependencies_of_expression(graph, node, stmt->condition);
+        add_dependencies_of_block(graph, node, stmt->body);
+        break;
+
+    case ELSE_SEGMENT:
+    case BREAK_LOOP:
+        add_dependencies_of_block(graph, node, stmt->body);
+        break;
+
+    case FOR_LOOP:
+        add_dependencies_of_expression(graph, node, stmt->iterable);
+        add_dependencies_of_block(graph, node, stmt->body);
+        break;
+
+    case BREAK_STATEMENT:
+        break;
+
+    case ASSIGNMENT_STATEMENT:
+        add_dependencies_of_expression(graph, node, stmt->assignment_lhs);
+        add_dependencies_of_expression(graph, node, stmt->assignment_rhs);
+        break;
+
+    case OUTPUT_STATEMENT:
+    case EXPRESSION_STMT:
+    case RETURN_STATEMENT:
+        if (stmt->expression)
+            add_dependencies_of_expression(graph, node, stmt->expression);
+        break;
 
     default:
-        fatal_error("Could not determine order of %s expression", expression_kind_string(expr->kind));
+        fatal_error("Could not determine dependencies of %s statement", statement_kind_string(stmt->kind));
         break;
     }
+}
+
+// Visit everything a node depends on, and once a whole strongly connected component has been visited, append its
+// variables to the initialisers. Components are completed after every component they depend on.
+void order_strongly_connected_nodes(DependencyGraph *graph, DependencyNode *node)
+{
+    node->index = node->lowlink = ++graph->next_index;
+    node->on_stack = true;
+    node->below = graph->stack;
+    graph->stack = node;
+
+    if (node->declaration)
+    {
+        if (node->declaration->initial_value)
+            add_dependencies_of_expression(graph, node, node->declaration->initial_value);
+    }
+    else
+    {
+        // NOTE: Lazy bodies are parsed once referenced, so a function without a body is never called
+        Function *funct = (Function *)node->ptr;
+        if (funct->body)
+            add_dependencies_of_block(graph, node, funct->body);
+    }
+
+    if (node->lowlink != node->index)
+        return;
+
+    // Any variable in a component with more than one node is part of a cycle
+    bool is_cycle = node->depends_on_itself || graph->stack != node;
+
+    DependencyNode *member;
+    do
+    {
+        member = graph->stack;
+        graph->stack = member->below;
+        member->on_stack = false;
 
-    unreachable;
+        if (member->declaration)
+        {
+            Block *block = graph->block;
+            member->depends_on_itself = is_cycle;
+            member->declaration->variable->order = block->initialiser_count;
+            block->initialisers[block->initialiser_count++] = member->declaration;
+        }
+    } while (member != node);
 }
 
-// FIXME: This will loop forever if variables recursively refer to each other in their initial values
-void resolve_variable_orders(Compiler *c, Program *apm, Block *block)
+void resolve_initialisation_order(Compiler *c, Program *apm, Block *block)
 {
     assert(block->declaration_block);
-    block->max_var_order = 0;
+
+    DependencyGraph graph;
+    graph.c = c;
+    graph.apm = apm;
+    init_allocator(&graph.allocator);
+    graph.slot = NULL;
+    graph.node_count = 0;
+    graph.capacity = 0;
+    graph.stack = NULL;
+    graph.next_index = 0;
+    graph.block = block;
 
     Statement *stmt;
     Iterator it;
 
+    it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
+    {
+        if (stmt->kind == VARIABLE_DECLARATION)
+            add_dependency_node(&graph, stmt->variable, stmt);
+        else if (stmt->kind == STRUCT_TYPE_DECLARATION)
+            resolve_initialisation_order(c, apm, stmt->struct_type->body);
+    }
+
+    block->initialisers = (Statement **)allocate_chunk(&c->list_arena, sizeof(Statement *) * graph.node_count, alignof(Statement *));
+    block->initialiser_count = 0;
+
+    // Visit variables in source order, so independent variables are still initialised in the order they are declared
     it = create_iterator(&block->statements);
     while (stmt = advance_iterator_of(&it, Statement))
     {
         if (stmt->kind != VARIABLE_DECLARATION)
             continue;
 
-        stmt->variable->order = 0;
+        DependencyNode *node = find_dependency_node(&graph, stmt->variable);
+        if (node->index == 0)
+            order_strongly_connected_nodes(&graph, node);
     }
 
-    bool changes_made = true;
-    while (changes_made)
+    // Report cycles in source order
+    it = create_iterator(&block->statements);
+    while (stmt = advance_iterator_of(&it, Statement))
     {
-        changes_made = false;
-
-        it = create_iterator(&block->statements);
-        while (stmt = advance_iterator_of(&it, Statement))
-        {
-            if (stmt->kind == VARIABLE_DECLARATION && stmt->initial_value)
-            {
-                size_t order = determine_order_of_expression(c, apm, stmt->initial_value) + 1;
-                if (order > stmt->variable->order)
-                {
-                    stmt->variable->order = order;
-
-                    if (order > block->max_var_order)
-                        block->max_var_order = order;
-
-                    changes_made = true;
-                }
-            }
-        }
+        if (stmt->kind == VARIABLE_DECLARATION && find_dependency_node(&graph, stmt->variable)->depends_on_itself)
+            raise_compilation_error(c, GLOBAL_VARIABLE_DEPENDS_ON_ITSELF, stmt->span);
     }
+
+    release_allocator(&graph.allocator);
 }
 
 // RESOLVE //
@@ -963,7 +1316,9 @@ void resolve_variable_orders(Compiler *c, Program *apm, Block *block)
 void resolve(Compiler *c, Program *apm)
 {
     determine_main_function(c, apm);
+    if (apm->main)
+        resolve_identities_in_lazy_function_body(c, apm, apm->main);
     resolve_identities_in_declaration_block(c, apm, apm->program_block);
     resolve_types_in_declaration_block(c, apm, apm->program_block);
-    resolve_variable_orders(c, apm, apm->program_block); // FIXME: This will not tree-walk into nested declaration blocks
+    resolve_initialisation_order(c, apm, apm->program_block);
 }
\ No newline at end of file
@@ -19,6 +19,125 @@ bool is_word_or_digit(const char c)
     return is_word(c) || is_digit(c);
 }
 
+// SCANNING //
+// Runs of characters of the same class (e.g. the rest of an identifier, or a comment) are scanned
+// 16 or 32 bytes at a time when the CPU supports it, and one byte at a time otherwise.
+// NOTE: Vector loads never cross a page boundary, meaning that reading past the null terminator at
+//       the end of the source text can never fault. No class contains the null terminator.
+
+typedef enum
+{
+    SCAN_WORD_OR_DIGIT,
+    SCAN_DIGIT,
+    SCAN_WHITESPACE,
+    SCAN_NOT_LINE_END,
+} ScanClass;
+
+bool is_in_scan_class(const char c, ScanClass scan_class)
+{
+    switch (scan_class)
+    {
+    case SCAN_WORD_OR_DIGIT:
+        return is_word_or_digit(c);
+    case SCAN_DIGIT:
+        return is_digit(c);
+    case SCAN_WHITESPACE:
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    case SCAN_NOT_LINE_END:
+        return c != '\n' && c != '\0';
+    }
+    unreachable;
+}
+
+// Returns the first character from `character` onwards that is not in the scan class
+const char *scan_scalar(const char *character, ScanClass scan_class)
+{
+    while (is_in_scan_class(*character, scan_class))
+        character++;
+    return character;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKENISE_SIMD
+#include <immintrin.h>
+
+#define SCAN_PAGE_SIZE 4096
+#define can_load_vector(ptr, size) (((uintptr_t)(ptr) & (SCAN_PAGE_SIZE - 1)) <= SCAN_PAGE_SIZE - (size))
+
+// Generate a vectorised scan function, where each byte is tested with signed comparisons.
+// Bytes >= 0x80 are negative, and so never fall inside any of the ranges below.
+#define DEFINE_SCAN_FUNCTION(name, isa, width, vec, load, set1, cmpeq, cmpgt, and_, or_, movemask) \
+    __attribute__((target(isa))) const char *name(const char *character, ScanClass scan_class)   \
+    {                                                                                                  \
+        while (true)                                                                                   \
+        {                                                                                              \
+            if (!can_load_vector(character, width))                                                    \
+            {                                                                                          \
+                if (!is_in_scan_class(*character, scan_class))                                         \
+                    return character;                                                                  \
+                character++;                                                                           \
+                continue;                                                                              \
+            }                                                                                          \
+                                                                                                       \
+            vec v = load((const vec *)character);                                                      \
+            vec in_class;                                                                              \
+            switch (scan_class)                                                                        \
+            {                                                                                          \
+            case SCAN_WORD_OR_DIGIT:                                                                   \
+            {                                                                                          \
+                vec lower = or_(v, set1(0x20));                                                        \
+                vec is_alpha = and_(cmpgt(lower, set1('a' - 1)), cmpgt(set1('z' + 1), lower));         \
+                vec is_num = and_(cmpgt(v, set1('0' - 1)), cmpgt(set1('9' + 1), v));                   \
+                in_class = or_(or_(is_alpha, is_num), cmpeq(v, set1('_')));                            \
+                break;                                                                                 \
+            }                                                                                          \
+            case SCAN_DIGIT:                                                                           \
+                in_class = and_(cmpgt(v, set1('0' - 1)), cmpgt(set1('9' + 1), v));                     \
+                break;                                                                                 \
+            case SCAN_WHITESPACE:                                                                      \
+                in_class = or_(or_(cmpeq(v, set1(' ')), cmpeq(v, set1('\t'))),                         \
+                               or_(cmpeq(v, set1('\n')), cmpeq(v, set1('\r'))));                       \
+                break;                                                                                 \
+            case SCAN_NOT_LINE_END:                                                                    \
+            default:                                                                                   \
+                in_class = or_(cmpeq(v, set1('\n')), cmpeq(v, set1('\0')));                            \
+                in_class = cmpeq(in_class, set1(0));                                                   \
+                break;                                                                                 \
+            }                                                                                          \
+                                                                                                       \
+            uint32_t outside_class = ~(uint32_t)movemask(in_class);                                    \
+            if (width < 32)                                                                            \
+                outside_class &= (uint32_t)((1ull << width) - 1);                                      \
+            if (outside_class)                                                                         \
+                return character + __builtin_ctz(outside_class);                                       \
+                                                                                                       \
+            character += width;                                                                        \
+        }                                                                                              \
+    }
+
+DEFINE_SCAN_FUNCTION(scan_sse2, "sse2", 16, __m128i, _mm_loadu_si128, _mm_set1_epi8, _mm_cmpeq_epi8, _mm_cmpgt_epi8, _mm_and_si128, _mm_or_si128, _mm_movemask_epi8)
+DEFINE_SCAN_FUNCTION(scan_avx2, "avx2", 32, __m256i, _mm256_loadu_si256, _mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_cmpgt_epi8, _mm256_and_si256, _mm256_or_si256, _mm256_movemask_epi8)
+
+#undef DEFINE_SCAN_FUNCTION
+#endif
+
+const char *(*scan)(const char *character, ScanClass scan_class) = NULL;
+Once scan_selected = ONCE_INIT;
+
+// Select the fastest scan function supported by the CPU
+void select_scan_function()
+{
+    scan = scan_scalar;
+
+#ifdef TOKENISE_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scan = scan_avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        scan = scan_sse2;
+#endif
+}
+
 // TOKENISE //
 
 #define ONE_CHAR(the_char, token_kind) \
@@ -38,17 +157,13 @@ bool is_word_or_digit(const char c)
         }                                                                 \
         break;
 
-#define IF_KEYWORD_ELSE(the_word, token_kind) \
-    if (strlen(the_word) == len &&            \
-        strncmp(start, the_word, len) == 0)   \
-        kind = token_kind;                    \
-    else
+#include "include/keyword_hash.c"
 
-void tokenise(Compiler *const c)
+// Advance `position` past the next token, skipping any whitespace and comments before it
+// Returns the kind of token, and sets `token_start` to where the token starts
+TokenKind tokenise_next(const char **position, const char **token_start)
 {
-    c->token_count = 0;
-
-    const char *character = c->source_text;
+    const char *character = *position;
     while (true)
     {
         const char *const start = character;
@@ -57,8 +172,7 @@ void tokenise(Compiler *const c)
         // Skip single line comments
         if (*character == '/' && *(character + 1) == '/')
         {
-            while (*character != '\n' && *character != '\0')
-                character++;
+            character = scan(character + 2, SCAN_NOT_LINE_END);
             continue;
         }
 
@@ -92,7 +206,7 @@ void tokenise(Compiler *const c)
         case '\t':
         case '\n':
         case '\r':
-            character++;
+            character = scan(character + 1, SCAN_WHITESPACE);
             continue; // Do not emit a token
 
         default:
@@ -100,42 +214,20 @@ void tokenise(Compiler *const c)
             if (is_digit(*character))
             {
                 kind = INTEGER;
-                while (true)
-                {
-                    if (*character == '.' && is_digit(*(character + 1)) && kind == INTEGER)
-                        kind = RATIONAL;
-                    else if (!is_digit(*character))
-                        break;
+                character = scan(character + 1, SCAN_DIGIT);
 
-                    character++;
+                if (*character == '.' && is_digit(*(character + 1)))
+                {
+                    kind = RATIONAL;
+                    character = scan(character + 2, SCAN_DIGIT);
                 }
             }
 
             else if (is_word(*character))
             {
-                while (is_word_or_digit(*character))
-                    character++;
+                character = scan(character + 1, SCAN_WORD_OR_DIGIT);
 
-                size_t len = character - start;
-                IF_KEYWORD_ELSE("and", KEYWORD_AND)
-                IF_KEYWORD_ELSE("break", KEYWORD_BREAK)
-                IF_KEYWORD_ELSE("def", KEYWORD_DEF)
-                IF_KEYWORD_ELSE("else", KEYWORD_ELSE)
-                IF_KEYWORD_ELSE("enum", KEYWORD_ENUM)
-                IF_KEYWORD_ELSE("false", KEYWORD_FALSE)
-                IF_KEYWORD_ELSE("fn", KEYWORD_FN)
-                IF_KEYWORD_ELSE("for", KEYWORD_FOR)
-                IF_KEYWORD_ELSE("if", KEYWORD_IF)
-                IF_KEYWORD_ELSE("in", KEYWORD_IN)
-                IF_KEYWORD_ELSE("loop", KEYWORD_LOOP)
-                IF_KEYWORD_ELSE("none", KEYWORD_NONE)
-                IF_KEYWORD_ELSE("not", KEYWORD_NOT)
-                IF_KEYWORD_ELSE("or", KEYWORD_OR)
-                IF_KEYWORD_ELSE("return", KEYWORD_RETURN)
-                IF_KEYWORD_ELSE("struct", KEYWORD_STRUCT)
-                IF_KEYWORD_ELSE("true", KEYWORD_TRUE)
-                IF_KEYWORD_ELSE("while", KEYWORD_WHILE)
-                kind = IDENTITY; // This is under the "else" of the above macro
+                kind = get_keyword_kind(start, character - start);
             }
 
             else if (*character == '"')
@@ -164,18 +256,521 @@ void tokenise(Compiler *const c)
             }
         }
 
-        if (c->token_count == c->token_capacity)
+        *position = character;
+        *token_start = start;
+        return kind;
+    }
+}
+
+// NUMBERS //
+// Number tokens are converted to their values as they are tokenised.
+// Rational numbers are converted using the Eisel-Lemire algorithm, which gives correctly rounded
+// results for almost all inputs, falling back to strtod for the rare inputs it cannot decide.
+
+#include "include/power_of_ten.c"
+
+// NOTE: Integer literals are never negative, so -1 marks a literal that is too large, which the parser reports
+int64_t convert_integer(const char *str, size_t len)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint64_t digit = str[i] - '0';
+        if (value > (INT64_MAX - digit) / 10)
+            return -1;
+        value = value * 10 + digit;
+    }
+    return (int64_t)value;
+}
+
+// Converts mantissa * 10^exponent to a double, returning false if the result could not be determined
+bool eisel_lemire(uint64_t mantissa, int exponent, double *result)
+{
+    if (mantissa == 0)
+    {
+        *result = 0;
+        return true;
+    }
+
+    if (exponent < POWER_OF_TEN_MIN || exponent > POWER_OF_TEN_MAX)
+        return false;
+
+    // Normalise the mantissa
+    int leading_zeros = __builtin_clzll(mantissa);
+    mantissa <<= leading_zeros;
+    uint64_t binary_exponent = (uint64_t)(((217706 * exponent) >> 16) + 64 + 1023) - leading_zeros;
+
+    // Multiply by the high half of the power of ten
+    const uint64_t *power = power_of_ten[exponent - POWER_OF_TEN_MIN];
+    __uint128_t product = (__uint128_t)mantissa * power[0];
+    uint64_t high = (uint64_t)(product >> 64);
+    uint64_t low = (uint64_t)product;
+
+    // Use the low half of the power of ten when the result is too close to call
+    if ((high & 0x1FF) == 0x1FF && low + mantissa < mantissa)
+    {
+        __uint128_t low_product = (__uint128_t)mantissa * power[1];
+        uint64_t merged_high = high;
+        uint64_t merged_low = low + (uint64_t)(low_product >> 64);
+        if (merged_low < low)
+            merged_high++;
+
+        if ((merged_high & 0x1FF) == 0x1FF && merged_low + 1 == 0 && (uint64_t)low_product + mantissa < mantissa)
+            return false;
+
+        high = merged_high;
+        low = merged_low;
+    }
+
+    // Shift to 54 bits
+    uint64_t top_bit = high >> 63;
+    uint64_t result_mantissa = high >> (top_bit + 9);
+    binary_exponent -= 1 ^ top_bit;
+
+    // Halfway between two doubles
+    if (low == 0 && (high & 0x1FF) == 0 && (result_mantissa & 3) == 1)
+        return false;
+
+    // Round to 53 bits
+    result_mantissa += result_mantissa & 1;
+    result_mantissa >>= 1;
+    if (result_mantissa >> 53 > 0)
+    {
+        result_mantissa >>= 1;
+        binary_exponent++;
+    }
+
+    // Subnormal, infinite or NaN
+    if (binary_exponent - 1 >= 0x7FF - 1)
+        return false;
+
+    uint64_t bits = binary_exponent << 52 | (result_mantissa & 0x000FFFFFFFFFFFFF);
+    memcpy(result, &bits, sizeof(double));
+    return true;
+}
+
+double convert_rational(const char *str, size_t len)
+{
+    // Read up to 19 significant digits, which will always fit in 64 bits
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    size_t digit_count = 0;
+    bool truncated = false;
+    bool after_point = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (str[i] == '.')
+        {
+            after_point = true;
+            continue;
+        }
+
+        if (digit_count == 0 && str[i] == '0')
+        {
+            if (after_point)
+                exponent--;
+            continue;
+        }
+
+        if (digit_count < 19)
+        {
+            mantissa = mantissa * 10 + (str[i] - '0');
+            digit_count++;
+            if (after_point)
+                exponent--;
+        }
+        else
+        {
+            truncated = true;
+            if (!after_point)
+                exponent++;
+        }
+    }
+
+    if (!truncated)
+    {
+        // When both the mantissa and power of ten are exact doubles, a single operation is correctly rounded
+        static const double exact_power_of_ten[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        if (mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
         {
-            c->token_capacity = c->token_capacity * 2;
-            c->tokens = (Token *)realloc(c->tokens, sizeof(Token) * c->token_capacity);
+            if (exponent >= 0)
+                return (double)mantissa * exact_power_of_ten[exponent];
+            return (double)mantissa / exact_power_of_ten[-exponent];
         }
 
-        c->tokens[c->token_count].kind = kind;
-        c->tokens[c->token_count].str.pos = start - c->source_text;
-        c->tokens[c->token_count].str.len = character - start;
-        c->token_count++;
+        double result;
+        if (eisel_lemire(mantissa, exponent, &result))
+            return result;
+    }
+
+    // Fall back to strtod, which needs a null terminated copy of the token
+    char buffer[64];
+    char *copy = len < sizeof(buffer) ? buffer : (char *)malloc(len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    double result = strtod(copy, NULL);
+    if (copy != buffer)
+        free(copy);
+    return result;
+}
+
+// Returns the value of number tokens
+// NOTE: This does not intern identities, so that it can be used when tokenising in parallel
+TokenValue convert_token_value(TokenKind kind, const char *start, size_t len)
+{
+    TokenValue value;
+    if (kind == INTEGER)
+        value.integer = convert_integer(start, len);
+    else if (kind == RATIONAL)
+        value.rational = convert_rational(start, len);
+    else
+        value.integer = 0;
+    return value;
+}
+
+TokenValue get_token_value(Compiler *c, TokenKind kind, const char *start, size_t len)
+{
+    if (kind != IDENTITY)
+        return convert_token_value(kind, start, len);
+
+    TokenValue value;
+    value.integer = 0;
+    value.atom = intern_atom(&c->atoms, start, len);
+    return value;
+}
+
+void check_source_length(Compiler *c)
+{
+    if (strlen(c->source_text) >= UINT32_MAX)
+        fatal_error("Source files larger than 4GB are not supported.");
+}
+
+void map_source_lines(Compiler *c, size_t source_length)
+{
+    free_source_map(&c->source_map);
+    init_source_map(&c->source_map);
+    add_source_lines(&c->source_map, c->source_text, 0, source_length);
+}
+
+// PARALLEL TOKENISATION //
+// Large sources are split into chunks that are tokenised on separate threads.
+// Strings and comments cannot span multiple lines, so every line starts on a token boundary,
+// and splitting the source at the end of a line never changes how the source is tokenised.
+
+#define PARALLEL_TOKENISE_MIN_CHUNK_SIZE (1 << 20)
+#define PARALLEL_TOKENISE_MAX_CHUNKS 64
+
+typedef struct
+{
+    const char *source_text;
+    const char *begin;
+    const char *end; // Tokens that start at or after `end` belong to the next chunk
+    bool last;       // The last chunk also includes the END_OF_FILE token
+    TokenArray tokens;
+    SourceMap source_map;
+} TokeniseChunk;
+
+void *tokenise_chunk(void *arg)
+{
+    TokeniseChunk *chunk = (TokeniseChunk *)arg;
+    init_token_array(&chunk->tokens, (chunk->end - chunk->begin) / 4 + 16);
+
+    init_source_map(&chunk->source_map);
+    add_source_lines(&chunk->source_map, chunk->source_text, chunk->begin - chunk->source_text, chunk->end - chunk->source_text);
+
+    const char *character = chunk->begin;
+    while (true)
+    {
+        const char *start;
+        TokenKind kind = tokenise_next(&character, &start);
+        if (start >= chunk->end && !chunk->last)
+            break;
+
+        push_token(&chunk->tokens, kind, start - chunk->source_text, character - start, convert_token_value(kind, start, character - start));
+
+        if (kind == END_OF_FILE)
+            break;
+    }
+
+    return NULL;
+}
+
+void tokenise_in_parallel(Compiler *c, size_t source_length, size_t chunk_count)
+{
+    TokeniseChunk chunks[PARALLEL_TOKENISE_MAX_CHUNKS];
+    Thread threads[PARALLEL_TOKENISE_MAX_CHUNKS];
+
+    // Split the source at line ends
+    const char *source_end = c->source_text + source_length;
+    const char *begin = c->source_text;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        const char *end = source_end;
+        if (i < chunk_count - 1)
+        {
+            end = c->source_text + source_length / chunk_count * (i + 1);
+            if (end < begin)
+                end = begin;
+            while (end < source_end && *end != '\n')
+                end++;
+            if (end < source_end)
+                end++; // Include the newline
+        }
+
+        chunks[i].source_text = c->source_text;
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        chunks[i].last = i == chunk_count - 1;
+        begin = end;
+    }
+
+    // Tokenise each chunk, using this thread for the first chunk
+    for (size_t i = 1; i < chunk_count; i++)
+        start_thread(&threads[i], tokenise_chunk, (void *)&chunks[i]);
+    tokenise_chunk((void *)&chunks[0]);
+    for (size_t i = 1; i < chunk_count; i++)
+        join_thread(&threads[i]);
+
+    // Stitch the chunks together in order
+    size_t token_count = 0;
+    for (size_t i = 0; i < chunk_count; i++)
+        token_count += chunks[i].tokens.count;
+
+    free_token_array(&c->tokens);
+    init_token_array(&c->tokens, token_count);
+
+    TokenArray *tokens = &c->tokens;
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        TokenArray *chunk_tokens = &chunks[i].tokens;
+        memcpy(tokens->kind + tokens->count, chunk_tokens->kind, sizeof(uint8_t) * chunk_tokens->count);
+        memcpy(tokens->pos + tokens->count, chunk_tokens->pos, sizeof(uint32_t) * chunk_tokens->count);
+        memcpy(tokens->len + tokens->count, chunk_tokens->len, sizeof(uint32_t) * chunk_tokens->count);
+        memcpy(tokens->value + tokens->count, chunk_tokens->value, sizeof(TokenValue) * chunk_tokens->count);
+        tokens->count += chunk_tokens->count;
+
+        free_token_array(chunk_tokens);
+    }
+
+    free_source_map(&c->source_map);
+    init_source_map(&c->source_map);
+    for (size_t i = 0; i < chunk_count; i++)
+    {
+        append_source_map(&c->source_map, &chunks[i].source_map);
+        free_source_map(&chunks[i].source_map);
+    }
+
+    // Intern identifiers
+    // NOTE: This is done after stitching, as the atom table is not thread safe
+    for (size_t i = 0; i < tokens->count; i++)
+    {
+        if (tokens->kind[i] == IDENTITY)
+            tokens->value[i].atom = intern_atom(&c->atoms, c->source_text + tokens->pos[i], tokens->len[i]);
+    }
+}
+
+// TOKENISE //
+
+void tokenise(Compiler *const c)
+{
+    check_source_length(c);
+
+    run_once(&scan_selected, select_scan_function);
+
+    size_t source_length = strlen(c->source_text);
+    size_t chunk_count = source_length / PARALLEL_TOKENISE_MIN_CHUNK_SIZE;
+    size_t processor_count = get_processor_count();
+    if (chunk_count > processor_count)
+        chunk_count = processor_count;
+    if (c->tokenise_chunk_count)
+        chunk_count = c->tokenise_chunk_count;
+    if (chunk_count > PARALLEL_TOKENISE_MAX_CHUNKS)
+        chunk_count = PARALLEL_TOKENISE_MAX_CHUNKS;
+
+    if (chunk_count > 1)
+    {
+        tokenise_in_parallel(c, source_length, chunk_count);
+        return;
+    }
+
+    map_source_lines(c, source_length);
+
+    // Presize the token array using an estimate of the number of tokens in the source text
+    free_token_array(&c->tokens);
+    init_token_array(&c->tokens, source_length / 4 + 16);
+
+    const char *character = c->source_text;
+    while (true)
+    {
+        const char *start;
+        TokenKind kind = tokenise_next(&character, &start);
+        push_token(&c->tokens, kind, start - c->source_text, character - start, get_token_value(c, kind, start, character - start));
 
         if (kind == END_OF_FILE)
             break;
     }
 }
+
+// STREAMING //
+// When streaming, tokens are tokenised as the parser requires them. Once the parser no longer
+// needs a token it is released, and its space in the token array can be reused. This means the
+// size of the token array depends on the size of the largest declaration, not the whole file.
+
+#define TOKEN_STREAM_INITIAL_CAPACITY 1024
+#define TOKEN_STREAM_BATCH_SIZE 256
+
+void *run_token_stream_thread(void *arg)
+{
+    Compiler *c = (Compiler *)arg;
+    TokenStream *stream = c->token_stream;
+    TokenArray *tokens = &c->tokens;
+
+    TokenKind kind[TOKEN_STREAM_BATCH_SIZE];
+    size_t pos[TOKEN_STREAM_BATCH_SIZE];
+    size_t len[TOKEN_STREAM_BATCH_SIZE];
+    TokenValue value[TOKEN_STREAM_BATCH_SIZE];
+
+    bool ended = false;
+    while (!ended)
+    {
+        // Tokenise a batch without holding the lock
+        size_t batch_count = 0;
+        while (batch_count < TOKEN_STREAM_BATCH_SIZE && !ended)
+        {
+            const char *start;
+            kind[batch_count] = tokenise_next(&stream->next_character, &start);
+            pos[batch_count] = start - c->source_text;
+            len[batch_count] = stream->next_character - start;
+            value[batch_count] = get_token_value(c, kind[batch_count], start, len[batch_count]); // NOTE: Only this thread uses the atom table while streaming
+            ended = kind[batch_count] == END_OF_FILE;
+            batch_count++;
+        }
+
+        // Push the batch to the token array
+        lock_mutex(&stream->mutex);
+        for (size_t i = 0; i < batch_count; i++)
+        {
+            // NOTE: The array is only grown while the parser is waiting, as the parser reads tokens without holding the lock
+            while (is_token_array_full(tokens) && tokens->retain_from <= tokens->first && !stream->parser_waiting)
+                wait_for_condition(&stream->tokens_released, &stream->mutex);
+
+            if (is_token_array_full(tokens))
+                make_space_in_token_array(tokens);
+
+            size_t slot = TOKEN_SLOT(tokens, tokens->count);
+            tokens->kind[slot] = (uint8_t)kind[i];
+            tokens->pos[slot] = (uint32_t)pos[i];
+            tokens->len[slot] = (uint32_t)len[i];
+            tokens->value[slot] = value[i];
+            atomic_store(&tokens->count, tokens->count + 1);
+        }
+
+        if (ended)
+            stream->ended = true;
+
+        signal_condition(&stream->tokens_pushed);
+        unlock_mutex(&stream->mutex);
+    }
+
+    return NULL;
+}
+
+void start_token_stream(Compiler *c, bool threaded)
+{
+    check_source_length(c);
+
+    run_once(&scan_selected, select_scan_function);
+
+    map_source_lines(c, strlen(c->source_text));
+
+    free_token_array(&c->tokens);
+    init_token_array(&c->tokens, TOKEN_STREAM_INITIAL_CAPACITY);
+
+    TokenStream *stream = &c->stream;
+    stream->next_character = c->source_text;
+    stream->ended = false;
+    stream->threaded = threaded;
+    stream->parser_waiting = false;
+    c->token_stream = stream;
+
+    if (threaded)
+    {
+        init_mutex(&stream->mutex);
+        init_condition(&stream->tokens_pushed);
+        init_condition(&stream->tokens_released);
+        start_thread(&stream->thread, run_token_stream_thread, (void *)c);
+    }
+}
+
+// Ensure that token `i` has been tokenised
+void require_token(Compiler *c, size_t i)
+{
+    TokenStream *stream = c->token_stream;
+    TokenArray *tokens = &c->tokens;
+
+    if (i < atomic_load(&tokens->count))
+        return;
+
+    if (stream->threaded)
+    {
+        lock_mutex(&stream->mutex);
+        stream->parser_waiting = true;
+        signal_condition(&stream->tokens_released);
+        while (i >= tokens->count && !stream->ended)
+            wait_for_condition(&stream->tokens_pushed, &stream->mutex);
+        stream->parser_waiting = false;
+        unlock_mutex(&stream->mutex);
+        return;
+    }
+
+    while (i >= tokens->count && !stream->ended)
+    {
+        const char *start;
+        TokenKind kind = tokenise_next(&stream->next_character, &start);
+        size_t len = stream->next_character - start;
+        push_token(tokens, kind, start - c->source_text, len, get_token_value(c, kind, start, len));
+        stream->ended = kind == END_OF_FILE;
+    }
+}
+
+// Allow the tokens before token `i` to be discarded
+void release_tokens_before(Compiler *c, size_t i)
+{
+    TokenStream *stream = c->token_stream;
+    TokenArray *tokens = &c->tokens;
+
+    if (!stream->threaded)
+    {
+        tokens->retain_from = i;
+        return;
+    }
+
+    lock_mutex(&stream->mutex);
+    tokens->retain_from = i;
+    signal_condition(&stream->tokens_released);
+    unlock_mutex(&stream->mutex);
+}
+
+void end_token_stream(Compiler *c)
+{
+    TokenStream *stream = c->token_stream;
+
+    if (stream->threaded)
+    {
+        // Let the tokeniser finish, in case the parser stopped before the end of the file
+        lock_mutex(&stream->mutex);
+        stream->parser_waiting = true;
+        signal_condition(&stream->tokens_released);
+        unlock_mutex(&stream->mutex);
+
+        join_thread(&stream->thread);
+        free_condition(&stream->tokens_released);
+        free_condition(&stream->tokens_pushed);
+        free_mutex(&stream->mutex);
+    }
+
+    c->token_stream = NULL;
+}
@@ -7,4 +7,9 @@
 
 void tokenise(Compiler *compiler);
 
+void start_token_stream(Compiler *c, bool threaded);
+void require_token(Compiler *c, size_t i);
+void release_tokens_before(Compiler *c, size_t i);
+void end_token_stream(Compiler *c);
+
 #endif
\ No newline at end of file
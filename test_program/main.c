@@ -8,11 +8,43 @@
 
 // STRING BUFFERS //
 
+#ifdef _WIN32
+#define PATH_SEPARATOR '\\'
+#else
+#define PATH_SEPARATOR '/'
+#endif
+
 char active_path[512];
 
-char rhino_cmd[512];
+char rhino_cmd[1024];
 size_t rhino_cmd_arg_start;
 
+// MODES //
+// Every test is run in each mode, and should give the same results in all of them
+
+typedef struct
+{
+    const char *name;
+    const char *flags;
+    bool reports_all_errors; // Otherwise, only tests expected to succeed are run in this mode
+    bool reads_stdin;        // The source is piped to the compiler, rather than read from its path
+} Mode;
+
+Mode modes[] = {
+    {"default", "", true, false},
+    {"snapshot", " -snapshot", true, false},
+    {"lazy", " -lazy", true, false},
+    {"lazy-parse", " -lazy-parse", false, false},
+    {"stream", " -stream", true, false},
+    {"stream-thread", " -stream-thread", true, false},
+    {"split", " -split", true, false},
+    {"parallel", " -parallel", true, false},
+    {"stdin", "", true, true},
+    {"memstats", " -memstats", true, false},
+};
+
+#define MODE_COUNT (sizeof(modes) / sizeof(Mode))
+
 // STRING UTILITY METHODS //
 
 bool is_comment(char *str)
@@ -120,20 +152,21 @@ void write(Page *page, const char *str, ...)
 
 // RUN RHINO COMPILER //
 
-bool run_rhino_compiler_cmd(Results *result, size_t active_path_len)
+bool run_rhino_compiler_cmd(Results *result, size_t active_path_len, Mode *mode)
 {
     // Update string
     {
         size_t c = rhino_cmd_arg_start;
-        memcpy(rhino_cmd + c, active_path, active_path_len - 1);
-        c += active_path_len - 1;
-        rhino_cmd[c++] = ' ';
-        rhino_cmd[c++] = '-';
-        rhino_cmd[c++] = 't';
-        rhino_cmd[c++] = 'e';
-        rhino_cmd[c++] = 's';
-        rhino_cmd[c++] = 't';
-        rhino_cmd[c++] = '\0';
+        if (mode->reads_stdin)
+        {
+            sprintf(rhino_cmd + c, "- -test%s < %s", mode->flags, active_path);
+        }
+        else
+        {
+            memcpy(rhino_cmd + c, active_path, active_path_len - 1);
+            c += active_path_len - 1;
+            sprintf(rhino_cmd + c, " -test%s", mode->flags);
+        }
     }
 
     // Run the command
@@ -210,58 +243,57 @@ Results determine_expectation()
 
 // TEST RHINO PROGRAM //
 
-void test_program_at_active_path(size_t active_path_len)
+void test_program_in_mode(Results *expected_result, size_t active_path_len, Mode *mode)
 {
-    // Determine expectation
-    Results expected_result = determine_expectation();
-
     // Determine actual results
     Results actual_result;
     actual_result.outcome = INVALID;
     actual_result.output_count = 0;
 
-    bool rhino_build = run_rhino_compiler_cmd(&actual_result, active_path_len);
+    if (!mode->reports_all_errors && expected_result->outcome != SUCCESS)
+    {
+        write(first_page, "<td class=\"result\">-</td>");
+        return;
+    }
+
+    bool rhino_build = run_rhino_compiler_cmd(&actual_result, active_path_len, mode);
     if (!rhino_build)
     {
         printf("ERROR: Could not execute command\n");
+        write(first_page, "<td class=\"result result-fail\">ERROR</td>");
         return;
     }
 
     // Compare results
-    bool test_passed = results_match(expected_result, actual_result);
+    bool test_passed = results_match(*expected_result, actual_result);
 
     // Output results to HTML
-    write(first_page, "\n<tr>");
-    write(first_page, "<td><a href=\"%s\">%s</a></td>", active_path, active_path);
-
     if (test_passed)
         write(first_page, "<td class=\"result\">YES</td>");
-    else if (expected_result.outcome == NOT_FOUND)
+    else if (expected_result->outcome == NOT_FOUND)
         write(first_page, "<td class=\"result result-fail\"><a href=\"#F%03d\">NOT FOUND</a></td>", failed_test_id);
     else if (actual_result.outcome == FATAL_ERROR)
         write(first_page, "<td class=\"result result-fail\"><a href=\"#F%03d\">FATAL</a></td>", failed_test_id);
     else
         write(first_page, "<td class=\"result result-fail\"><a href=\"#F%03d\">NO</a></td>", failed_test_id);
 
-    write(first_page, "</tr>");
-
     if (!test_passed)
     {
         Page *error_info = create_page(4096);
         current_page->next_page = error_info;
         current_page = error_info;
 
-        write(error_info, "\n<h2 id=\"F%03d\"><a href=\"%s\">%s</a></h2>", failed_test_id, active_path, active_path);
+        write(error_info, "\n<h2 id=\"F%03d\"><a href=\"%s\">%s</a> (%s)</h2>", failed_test_id, active_path, active_path, mode->name);
 
         write(error_info, "<table>");
         write(error_info, "<tr><th>Expected</th><th>Actual</th></tr>");
         write(error_info, "<tr><td>");
 
-        write(error_info, "<b>%s</b>", outcome_string(expected_result.outcome));
-        for (size_t i = 0; i < expected_result.output_count; i++)
+        write(error_info, "<b>%s</b>", outcome_string(expected_result->outcome));
+        for (size_t i = 0; i < expected_result->output_count; i++)
         {
             write(error_info, "<br>");
-            write(error_info, expected_result.output[i]);
+            write(error_info, expected_result->output[i]);
         }
 
         write(error_info, "</td><td>");
@@ -278,6 +310,22 @@ void test_program_at_active_path(size_t active_path_len)
     }
 }
 
+void test_program_at_active_path(size_t active_path_len)
+{
+    // Determine expectation
+    Results *expected_result = (Results *)malloc(sizeof(Results));
+    *expected_result = determine_expectation();
+
+    write(first_page, "\n<tr>");
+    write(first_page, "<td><a href=\"%s\">%s</a></td>", active_path, active_path);
+
+    for (size_t i = 0; i < MODE_COUNT; i++)
+        test_program_in_mode(expected_result, active_path_len, &modes[i]);
+
+    write(first_page, "</tr>");
+    free(expected_result);
+}
+
 // SCAN DIRECTORY //
 
 void scan_directory(DIR *dir, size_t path_len)
@@ -294,7 +342,7 @@ void scan_directory(DIR *dir, size_t path_len)
 
     // Extend active path ready for item paths
     path_len--;
-    active_path[path_len++] = '\\';
+    active_path[path_len++] = PATH_SEPARATOR;
     active_path[path_len++] = '\0';
 
     // For each item
@@ -363,7 +411,7 @@ int main(int argc, char *argv[])
     memcpy(active_path, test_path, test_path_len + 1);
 
     // Prepare pages
-    first_page = create_page(65536);
+    first_page = create_page(1 << 20); // Each test has a row with a column for each mode
     current_page = first_page;
 
     // Scan tests directory
@@ -408,7 +456,11 @@ int main(int argc, char *argv[])
             "</style>"
             "</head><body>"
             "<table>"
-            "<tr><th>Test</th><th>Passed</th></tr>");
+            "<tr><th>Test</th>");
+
+    for (size_t i = 0; i < MODE_COUNT; i++)
+        fprintf(output_file, "<th>%s</th>", modes[i].name);
+    fprintf(output_file, "</tr>");
 
     Page *p = first_page;
     while (p != NULL)